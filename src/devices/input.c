@@ -1,16 +1,34 @@
 #include "devices/input.h"
 #include <debug.h>
+#include <stdio.h>
+#include <string.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/synch.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Serializes input_read() callers. */
+static struct lock read_lock;
+
+/* Canonical mode: input is edited a line at a time, with echo,
+   and each read returns at most one line. */
+static bool canonical;
+
+/* Line completed in canonical mode but not yet fully read. */
+static uint8_t line[INPUT_LINE_MAX];
+static size_t line_len;         /* Bytes in LINE. */
+static size_t line_ofs;         /* Bytes of LINE already read. */
+
+static void read_line (void);
+
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
   intq_init (&buffer);
+  lock_init (&read_lock);
 }
 
 /* Adds a key to the input buffer.
@@ -41,6 +59,61 @@ input_getc (void)
   return key;
 }
 
+/* Reads up to SIZE bytes of input into BUF and returns the
+   number read, which is at least 1 unless SIZE is 0.
+
+   In raw mode, waits for one key, then takes whatever other keys
+   are already buffered.  In canonical mode, waits for a complete
+   line and returns as much of it, including its new-line, as
+   fits; the rest is returned by later calls. */
+size_t
+input_read (uint8_t *buf, size_t size) 
+{
+  size_t n = 0;
+
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&read_lock);
+  if (canonical || line_ofs < line_len) 
+    {
+      if (line_ofs == line_len)
+        read_line ();
+      n = line_len - line_ofs;
+      if (n > size)
+        n = size;
+      memcpy (buf, line + line_ofs, n);
+      line_ofs += n;
+    }
+  else 
+    {
+      enum intr_level old_level = intr_disable ();
+      buf[n++] = intq_getc (&buffer);
+      while (n < size && !intq_empty (&buffer))
+        buf[n++] = intq_getc (&buffer);
+      serial_notify ();
+      intr_set_level (old_level);
+    }
+  lock_release (&read_lock);
+
+  return n;
+}
+
+/* Selects canonical mode if CANON is true, raw mode otherwise.
+   Returns the previous setting. */
+bool
+input_set_canonical (bool canon) 
+{
+  bool old;
+
+  lock_acquire (&read_lock);
+  old = canonical;
+  canonical = canon;
+  lock_release (&read_lock);
+
+  return old;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
@@ -50,3 +123,48 @@ input_full (void)
   ASSERT (intr_get_level () == INTR_OFF);
   return intq_full (&buffer);
 }
+
+/* Reads keys into LINE until a carriage return or new-line,
+   echoing them and handling backspace and Ctrl+U the way Unix
+   users expect.  The line always ends in a new-line character. */
+static void
+read_line (void) 
+{
+  line_len = line_ofs = 0;
+  for (;;) 
+    {
+      uint8_t c = input_getc ();
+
+      switch (c) 
+        {
+        case '\r':
+        case '\n':
+          line[line_len++] = '\n';
+          putchar ('\n');
+          return;
+
+        case '\b':
+        case 0x7f:
+          if (line_len > 0) 
+            {
+              line_len--;
+              printf ("\b \b");
+            }
+          break;
+
+        case ('U' - 'A') + 1:       /* Ctrl+U. */
+          for (; line_len > 0; line_len--)
+            printf ("\b \b");
+          break;
+
+        default:
+          /* Leave room for the new-line. */
+          if (line_len < INPUT_LINE_MAX - 1) 
+            {
+              line[line_len++] = c;
+              putchar (c);
+            }
+          break;
+        }
+    }
+}
@@ -2,11 +2,17 @@
 #define DEVICES_INPUT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/* Longest line returned in canonical mode, including new-line. */
+#define INPUT_LINE_MAX 256
+
 void input_init (void);
 void input_putc (uint8_t);
 uint8_t input_getc (void);
+size_t input_read (uint8_t *, size_t);
+bool input_set_canonical (bool);
 bool input_full (void);
 
 #endif /* devices/input.h */
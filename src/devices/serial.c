@@ -1,7 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <string.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -37,6 +37,12 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+
+/* Bytes the transmit FIFO holds. */
+#define XMIT_FIFO_SIZE 16
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -51,12 +57,27 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted: a ring buffer that the serial
+   interrupt drains into the FIFO, XMIT_FIFO_SIZE bytes at a
+   time.  TX_HEAD and TX_TAIL count bytes added and removed and
+   wrap around freely; TXBUF_SIZE must be a power of 2.
+   Accessed only with interrupts off. */
+#define TXBUF_SIZE 16384
+static uint8_t txbuf[TXBUF_SIZE];
+static unsigned tx_head;
+static unsigned tx_tail;
+
+/* Thread sleeping until the serial interrupt makes room in the
+   transmit buffer, if any.  TX_LOCK lets only one thread wait at
+   a time. */
+static struct lock tx_lock;
+static struct thread *tx_waiter;
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
+static bool tx_empty (void);
+static unsigned tx_room (void);
 static intr_handler_func serial_interrupt;
 
 /* Initializes the serial port device for polling mode.
@@ -71,7 +92,6 @@ init_poll (void)
   outb (FCR_REG, 0);                    /* Disable FIFO. */
   set_serial (115200);                  /* 115.2 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
   mode = POLL;
 } 
 
@@ -87,7 +107,9 @@ serial_init_queue (void)
     init_poll ();
   ASSERT (mode == POLL);
 
+  lock_init (&tx_lock);
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
+  outb (FCR_REG, FCR_ENABLE);           /* Enable 16-byte FIFOs. */
   mode = QUEUE;
   old_level = intr_disable ();
   write_ier ();
@@ -98,31 +120,73 @@ serial_init_queue (void)
 void
 serial_putc (uint8_t byte) 
 {
+  serial_putbuf (&byte, 1);
+}
+
+/* Sends the SIZE bytes in BUFFER to the serial port.  In queued
+   mode this normally just copies them into the transmit buffer
+   and returns. */
+void
+serial_putbuf (const void *buffer, size_t size) 
+{
+  const uint8_t *p = buffer;
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit the bytes. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (size-- > 0)
+        putc_poll (*p++); 
     }
   else 
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      while (size > 0) 
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          unsigned ofs = tx_head % TXBUF_SIZE;
+          unsigned chunk;
+
+          if (tx_room () == 0) 
+            {
+              if (old_level == INTR_OFF) 
+                {
+                  /* Interrupts are off and the transmit buffer is
+                     full.  If we wanted to wait for the buffer to
+                     drain, we'd have to reenable interrupts.
+                     That's impolite, so we'll send a byte via
+                     polling instead. */
+                  putc_poll (txbuf[tx_tail++ % TXBUF_SIZE]); 
+                }
+              else 
+                {
+                  /* Sleep until the serial interrupt makes
+                     room. */
+                  ASSERT (!intr_context ());
+                  write_ier ();
+                  lock_acquire (&tx_lock);
+                  if (tx_room () == 0) 
+                    {
+                      tx_waiter = thread_current ();
+                      thread_block ();
+                    }
+                  lock_release (&tx_lock);
+                }
+              continue;
+            }
+
+          /* Copy as much as fits before the buffer wraps. */
+          chunk = TXBUF_SIZE - ofs;
+          if (chunk > tx_room ())
+            chunk = tx_room ();
+          if (chunk > size)
+            chunk = size;
+          memcpy (txbuf + ofs, p, chunk);
+          tx_head += chunk;
+          p += chunk;
+          size -= chunk;
         }
-
-      intq_putc (&txq, byte); 
       write_ier ();
     }
   
@@ -135,8 +199,8 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (!tx_empty ())
+    putc_poll (txbuf[tx_tail++ % TXBUF_SIZE]);
   intr_set_level (old_level);
 }
 
@@ -182,7 +246,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (!tx_empty ())
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -218,11 +282,37 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If we have bytes to transmit and the transmit FIFO is empty,
+     fill it. */
+  if (!tx_empty () && (inb (LSR_REG) & LSR_THRE) != 0) 
+    {
+      int i;
+
+      for (i = 0; i < XMIT_FIFO_SIZE && !tx_empty (); i++)
+        outb (THR_REG, txbuf[tx_tail++ % TXBUF_SIZE]);
+
+      /* Wake up a writer waiting for room. */
+      if (tx_waiter != NULL) 
+        {
+          thread_unblock (tx_waiter);
+          tx_waiter = NULL;
+        }
+    }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
 }
+
+/* Returns true if there is nothing to transmit. */
+static bool
+tx_empty (void) 
+{
+  return tx_head == tx_tail;
+}
+
+/* Returns the number of free bytes in the transmit buffer. */
+static unsigned
+tx_room (void) 
+{
+  return TXBUF_SIZE - (tx_head - tx_tail);
+}
@@ -10,6 +10,10 @@ main (int argc, char *argv[])
 {
   bool success = true;
   int i;
+
+  /* Each dump line is several printf() calls, so buffer the
+     output in full rather than a line at a time. */
+  setvbuf (stdout, _IOFBF);
   
   for (i = 1; i < argc; i++) 
     {
@@ -24,39 +24,40 @@ list_dir (const char *dir, bool verbose)
 
   if (isdir (dir_fd))
     {
-      char name[READDIR_MAX_LEN];
+      struct dirent ents[32];
+      int cnt, i;
 
       printf ("%s", dir);
       if (verbose)
         printf (" (inumber %d)", inumber (dir_fd));
       printf (":\n");
 
-      while (readdir (dir_fd, name)) 
-        {
-          printf ("%s", name); 
-          if (verbose) 
-            {
-              char full_name[128];
-              int entry_fd;
+      while ((cnt = getdents (dir_fd, ents, sizeof ents)) > 0)
+        for (i = 0; i < cnt; i++)
+          {
+            const struct dirent *d = &ents[i];
 
-              snprintf (full_name, sizeof full_name, "%s/%s", dir, name);
-              entry_fd = open (full_name);
+            printf ("%s", d->name); 
+            if (verbose && d->is_dir)
+              printf (": directory, inumber %d", d->inumber);
+            else if (verbose) 
+              {
+                char full_name[128];
+                int entry_fd;
 
-              printf (": ");
-              if (entry_fd != -1)
-                {
-                  if (isdir (entry_fd))
-                    printf ("directory");
-                  else
-                    printf ("%d-byte file", filesize (entry_fd));
-                  printf (", inumber %d", inumber (entry_fd));
-                }
-              else
-                printf ("open failed");
-              close (entry_fd);
-            }
-          printf ("\n");
-        }
+                snprintf (full_name, sizeof full_name, "%s/%s", dir, d->name);
+                entry_fd = open (full_name);
+
+                printf (": ");
+                if (entry_fd != -1)
+                  printf ("%d-byte file, inumber %d",
+                          filesize (entry_fd), d->inumber);
+                else
+                  printf ("open failed");
+                close (entry_fd);
+              }
+            printf ("\n");
+          }
     }
   else 
     printf ("%s: not a directory\n", dir);
@@ -4,12 +4,12 @@
 #include <syscall.h>
 
 static void read_line (char line[], size_t);
-static bool backspace (char **pos, char line[]);
 
 int
 main (void)
 {
   printf ("Shell starting...\n");
+  ttymode (TTY_CANON);
   for (;;) 
     {
       char command[80];
@@ -40,65 +40,35 @@ main (void)
         }
     }
 
+  ttymode (TTY_RAW);
   printf ("Shell exiting.");
   return EXIT_SUCCESS;
 }
 
 /* Reads a line of input from the user into LINE, which has room
-   for SIZE bytes.  Handles backspace and Ctrl+U in the ways
-   expected by Unix users.  On return, LINE will always be
-   null-terminated and will not end in a new-line character. */
+   for SIZE bytes.  The kernel's canonical input mode handles
+   echo, backspace and Ctrl+U, and hands over a whole line per
+   read().  On return, LINE will always be null-terminated and
+   will not end in a new-line character. */
 static void
 read_line (char line[], size_t size) 
 {
-  char *pos = line;
-  for (;;)
-    {
-      char c;
-      read (STDIN_FILENO, &c, 1);
-
-      switch (c) 
-        {
-        case '\r':
-          *pos = '\0';
-          putchar ('\n');
-          return;
-
-        case '\b':
-          backspace (&pos, line);
-          break;
-
-        case ('U' - 'A') + 1:       /* Ctrl+U. */
-          while (backspace (&pos, line))
-            continue;
-          break;
+  int n;
 
-        default:
-          /* Add character to line. */
-          if (pos < line + size - 1) 
-            {
-              putchar (c);
-              *pos++ = c;
-            }
-          break;
-        }
-    }
-}
-
-/* If *POS is past the beginning of LINE, backs up one character
-   position.  Returns true if successful, false if nothing was
-   done. */
-static bool
-backspace (char **pos, char line[]) 
-{
-  if (*pos > line)
+  fflush (stdout);
+  n = read (STDIN_FILENO, line, size - 1);
+  if (n < 0)
+    n = 0;
+  if (n > 0 && line[n - 1] == '\n')
+    n--;
+  else 
     {
-      /* Back up cursor, overwrite character, back up
-         again. */
-      printf ("\b \b");
-      (*pos)--;
-      return true;
+      /* Discard the rest of an overlong line. */
+      char discard[64];
+      int m;
+      do
+        m = read (STDIN_FILENO, discard, sizeof discard);
+      while (m > 0 && discard[m - 1] != '\n');
     }
-  else
-    return false;
+  line[n] = '\0';
 }
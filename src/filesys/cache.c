@@ -1,5 +1,7 @@
 #include "filesys/cache.h"
+#include <string.h>
 #include "filesys/filesys.h"
+#include "threads/malloc.h"
 #include "threads/synch.h"
 #include "userprog/process.h"
 
@@ -9,10 +11,9 @@
 
 struct list buffer_cache; /* Buffer Cache */
 struct lock cache_lock;   /* Lock for Buffer Cache */
-struct lock disk_lock;    /* Lock for File Disk */
-
-struct lock insert_lock;
+struct condition cache_io_done; /* Signaled when an entry stops being busy */
 
+static struct cache_entry * cache_find (disk_sector_t sec_no);
 static struct cache_entry * cache_insert (disk_sector_t sec_no);
 static bool cache_evict (void);
 
@@ -22,71 +23,84 @@ cache_init (void)
 {
   list_init (&buffer_cache);
   lock_init (&cache_lock);
-  lock_init (&disk_lock);
-  lock_init (&insert_lock);
+  cond_init (&cache_io_done);
 
   //hash_init (&buffer_cache, cache_hash, cache_less, NULL);
   return;
 }
 
+/* Adds an entry for SEC_NO and reads it from disk.
+   Called with cache_lock held, which is dropped during the read;
+   the entry is marked busy meanwhile so nobody else uses it. */
 static struct cache_entry *
 cache_insert (disk_sector_t sec_no)
 {
-  lock_acquire (&insert_lock);
-
-  if (list_size (&buffer_cache) >= CACHE_SIZE_LIMIT)
-  {
-    ASSERT(cache_evict());
-  }
-
 	struct cache_entry *c = malloc(sizeof *c);
+  if (c == NULL)
+    return NULL;
 
   c -> sec_no = sec_no;
   c -> dirty = false;
   c -> access = false;
+  c -> pinned = false;
+  c -> busy = true;
+	list_push_back (&buffer_cache, &c->elem);
 
-  lock_acquire (&disk_lock);
+  lock_release (&cache_lock);
   disk_read (filesys_disk, sec_no, &c->block);
-  lock_release (&disk_lock);
-
-	lock_acquire(&cache_lock);
-	list_push_back (&buffer_cache, &c->elem);
-  lock_release(&cache_lock);
+  lock_acquire (&cache_lock);
 
-  lock_release (&insert_lock);
+  c -> busy = false;
+  cond_broadcast (&cache_io_done, &cache_lock);
 
   return c;
 }
 
+/* Evicts one entry, writing it back if dirty.
+   Called with cache_lock held. */
 static bool
 cache_evict (void)
 {
   ASSERT(!list_empty(&buffer_cache));
 
-  struct cache_entry *c = list_entry (list_begin (&buffer_cache), struct cache_entry, elem);
-  struct cache_entry *c_next;
-
-  /* cache replacement policy: second chance algorithm */
-  while (&c_next->elem != list_end(&buffer_cache))
+  struct cache_entry *c = NULL;
+  struct list_elem *e = list_begin (&buffer_cache);
+  size_t i, cnt = list_size (&buffer_cache);
+
+  /* cache replacement policy: second chance algorithm.
+     Pinned entries belong to an uncommitted journal transaction
+     and must not reach their home sector yet, so skip them,
+     along with entries that are in the middle of disk I/O.
+     Skipped entries stay where they are, so that cache_flush()
+     can resume its scan from a busy entry. */
+  for (i = 0; i < 2 * cnt; i++)
   {
-    c_next = list_entry (list_next (&c->elem), struct cache_entry, elem);
-    
-    if (c->access == true)
-    {
+    if (e == list_end (&buffer_cache))
+      e = list_begin (&buffer_cache);
+    c = list_entry (e, struct cache_entry, elem);
+    e = list_next (e);
+
+    if (c->pinned || c->busy)
+      continue;
+    list_remove (&c->elem);
+    list_push_back (&buffer_cache, &c->elem);
+    if (c->access)
       c->access = false;
-      list_remove (&c->elem);
-      list_push_back (&buffer_cache, &c->elem);
-    } else {
+    else
       break;
-    }
   }
+  if (i == 2 * cnt)
+    return false;
 
   if (c->dirty)
   {
     /* write back */
-    lock_acquire (&disk_lock);
+    c->busy = true;
+    lock_release (&cache_lock);
     disk_write (filesys_disk, c->sec_no, &c->block);
-    lock_release (&disk_lock);
+    lock_acquire (&cache_lock);
+    c->busy = false;
+    cond_broadcast (&cache_io_done, &cache_lock);
   }
 
   list_remove (&c->elem);
@@ -95,55 +109,122 @@ cache_evict (void)
   return true;
 }
 
-struct cache_entry *
+/* Returns the entry for SEC_NO, reading it in if needed.
+   Called with cache_lock held.  Returns a null pointer only if
+   memory is exhausted. */
+static struct cache_entry *
 cache_find (disk_sector_t sec_no)
 {
-  lock_acquire(&cache_lock);
-
   struct list_elem *e;
   struct cache_entry *c;
 
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+ retry:
   for (e = list_begin (&buffer_cache); e != list_end (&buffer_cache); e = list_next (e))
   {
     c = list_entry (e, struct cache_entry, elem);
     if (c->sec_no == sec_no)
     {
-      lock_release(&cache_lock);
+      if (c->busy)
+      {
+        /* Being read in or written back; look again afterward. */
+        cond_wait (&cache_io_done, &cache_lock);
+        goto retry;
+      }
       return c;
     }
   }
 
-  lock_release(&cache_lock);
-
-  c = cache_insert (sec_no);
-  ASSERT(c != NULL);
+  /* Eviction may drop the lock to write back, so someone else
+     may have brought SEC_NO in meanwhile.  If every entry is
+     pinned by the journal, let the cache grow past its limit
+     until the transaction commits. */
+  if (list_size (&buffer_cache) >= CACHE_SIZE_LIMIT && cache_evict ())
+    goto retry;
 
-  return c;
+  return cache_insert (sec_no);
 }
 
 bool
 cache_write (disk_sector_t sec_no, void* buffer, int ofs, int size)
 {
+  lock_acquire (&cache_lock);
   struct cache_entry *c = cache_find (sec_no);
   ASSERT(c!=NULL);
 
   memcpy ((uint8_t *) &c->block + ofs, buffer, size);
   c->dirty = true;
   c->access = true;
+  lock_release (&cache_lock);
   return true;
 }
 
 bool
 cache_read (disk_sector_t sec_no, void* buffer, int ofs, int size)
 {
+  lock_acquire (&cache_lock);
   struct cache_entry *c = cache_find (sec_no);
   ASSERT(c!=NULL);
 
   memcpy (buffer, (uint8_t *) &c->block + ofs, size);
   c->access = true;
+  lock_release (&cache_lock);
   return true;
 }
 
+/* Pins or unpins the cache entry for SEC_NO.  A pinned entry is
+   never evicted, so its contents cannot reach the disk before
+   the journal has logged them. */
+void
+cache_set_pinned (disk_sector_t sec_no, bool pinned)
+{
+  lock_acquire (&cache_lock);
+  struct cache_entry *c = cache_find (sec_no);
+  ASSERT(c!=NULL);
+
+  c->pinned = pinned;
+  lock_release (&cache_lock);
+}
+
+/* Writes every dirty, unpinned entry back to its home sector.
+   Returns only once all of them have reached the disk, including
+   those that cache_evict() is writing back, so the journal can
+   reuse the log afterward. */
+void
+cache_flush (void)
+{
+  struct list_elem *e;
+  struct cache_entry *c;
+
+  lock_acquire (&cache_lock);
+ retry:
+  for (e = list_begin (&buffer_cache); e != list_end (&buffer_cache); e = list_next (e))
+  {
+    c = list_entry (e, struct cache_entry, elem);
+    if (!c->dirty || c->pinned)
+      continue;
+    if (c->busy)
+    {
+      /* Being written back by eviction; wait for it. */
+      cond_wait (&cache_io_done, &cache_lock);
+      goto retry;
+    }
+
+    /* The list may change while the lock is dropped, so start
+       over afterward rather than trusting E. */
+    c->busy = true;
+    c->dirty = false;
+    lock_release (&cache_lock);
+    disk_write (filesys_disk, c->sec_no, &c->block);
+    lock_acquire (&cache_lock);
+    c->busy = false;
+    cond_broadcast (&cache_io_done, &cache_lock);
+    goto retry;
+  }
+  lock_release (&cache_lock);
+}
+
 
 
 
@@ -11,13 +11,16 @@ struct cache_entry			  /* Buffer Cache Entry */
   	uint8_t block[DISK_SECTOR_SIZE];
   	bool dirty;
   	bool access;
+  	bool pinned;              /* Held by a running journal transaction. */
+  	bool busy;                /* Disk I/O in progress. */
 
 	struct list_elem elem;
 };
 
 void cache_init (void);
-struct cache_entry * cache_find (disk_sector_t sec_no);
 
 bool cache_write (disk_sector_t sec_no, void* buffer, int ofs, int size);
 bool cache_read (disk_sector_t sec_no, void* buffer, int ofs, int size);
+void cache_set_pinned (disk_sector_t sec_no, bool pinned);
+void cache_flush (void);
 #endif /* filesys/cache.h */
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include <syscall-nr.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -15,12 +16,17 @@ struct dir
     off_t pos;                          /* Current position. */
   };
 
+/* Number of directory entries dir_readdir_batch() reads from
+   the inode at once, spanning several whole sectors. */
+#define DIR_BATCH 128
+
 /* A single directory entry. */
 struct dir_entry 
   {
     disk_sector_t inode_sector;         /* Sector number of header. */
     char name[NAME_MAX + 1];            /* Null terminated file name. */
     bool in_use;                        /* In use or free? */
+    bool is_dir;                        /* Names a directory? */
   };
 
 /* Creates a directory with space for ENTRY_CNT entries in the
@@ -136,12 +142,13 @@ dir_lookup (const struct dir *dir, const char *name,
 
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
-   INODE_SECTOR.
+   INODE_SECTOR, and is a directory if IS_DIR is true.
    Returns true if successful, false on failure.
    Fails if NAME is invalid (i.e. too long) or a disk or memory
    error occurs. */
 bool
-dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) 
+dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector,
+         bool is_dir) 
 {
   struct dir_entry e;
   off_t ofs;
@@ -155,6 +162,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
     return false;
 
   /* Check that NAME is not in use. */
+  inode_dir_lock (dir->inode);
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
@@ -174,9 +182,11 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
+  e.is_dir = is_dir;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
+  inode_dir_unlock (dir->inode);
   return success;
 }
 
@@ -195,6 +205,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
+  inode_dir_lock (dir->inode);
   if (!lookup (dir, name, &e, &ofs))
     goto done;
 
@@ -213,6 +224,7 @@ dir_remove (struct dir *dir, const char *name)
   success = true;
 
  done:
+  inode_dir_unlock (dir->inode);
   inode_close (inode);
   return success;
 }
@@ -237,6 +249,52 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
   return false;
 }
 
+/* Reads up to MAX in-use entries from DIR into ENTS, starting at
+   DIR's current position, and advances past them.  Returns the
+   number of entries read, which is 0 at the end of the
+   directory.  Unlike dir_readdir(), reads DIR_BATCH entries from
+   the inode per call to inode_read_at(), and takes each entry's
+   type from the entry itself rather than opening its inode. */
+size_t
+dir_readdir_batch (struct dir *dir, struct dirent *ents, size_t max)
+{
+  struct dir_entry *batch;
+  size_t cnt = 0;
+
+  ASSERT (sizeof ents->name >= NAME_MAX + 1);
+
+  batch = malloc (DIR_BATCH * sizeof *batch);
+  if (batch == NULL)
+    return 0;
+
+  while (cnt < max)
+    {
+      off_t bytes = inode_read_at (dir->inode, batch,
+                                   DIR_BATCH * sizeof *batch, dir->pos);
+      size_t batch_cnt = bytes / sizeof *batch;
+      size_t i;
+
+      if (batch_cnt == 0)
+        break;
+      for (i = 0; i < batch_cnt && cnt < max; i++) 
+        {
+          struct dir_entry *e = &batch[i];
+
+          dir->pos += sizeof *e;
+          if (e->in_use)
+            {
+              struct dirent *d = &ents[cnt++];
+
+              d->inumber = e->inode_sector;
+              d->is_dir = e->is_dir;
+              strlcpy (d->name, e->name, sizeof d->name);
+            }
+        }
+    }
+  free (batch);
+  return cnt;
+}
+
 
 
 
@@ -12,6 +12,7 @@
 #define NAME_MAX 14
 
 struct inode;
+struct dirent;
 
 /* Opening and closing directories. */
 bool dir_create (disk_sector_t sector, size_t entry_cnt);
@@ -23,9 +24,10 @@ struct inode *dir_get_inode (struct dir *);
 
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
-bool dir_add (struct dir *, const char *name, disk_sector_t);
+bool dir_add (struct dir *, const char *name, disk_sector_t, bool is_dir);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+size_t dir_readdir_batch (struct dir *, struct dirent *, size_t max);
 
 void split_path_filename(const char *path, char *directory, char *filename);
 struct dir *dir_open_path (const char *);
@@ -7,9 +7,13 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "filesys/cache.h"
+#include "filesys/journal.h"
 #include "devices/disk.h"
 
 #include "threads/thread.h"
+#ifdef USERPROG
+#include "userprog/process.h"
+#endif
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
@@ -28,6 +32,7 @@ filesys_init (bool format)
   inode_init ();
   free_map_init ();
   cache_init ();
+  journal_init (format);
 
   if (format) 
     do_format ();
@@ -40,7 +45,12 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+#ifdef USERPROG
+  process_done ();
+#endif
+  inode_flush_all ();
   free_map_close ();
+  journal_done ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -59,14 +69,20 @@ filesys_create (const char *path, off_t initial_size, bool is_dir)
   split_path_filename(path, directory, file_name);
   struct dir *dir = dir_open_path (directory);
 
+  /* A directory's data sectors are zero-filled through the
+     journal too. */
+  size_t data_cnt = DIV_ROUND_UP (initial_size, DISK_SECTOR_SIZE);
+  journal_begin (JOURNAL_OP_SECTORS + JOURNAL_INDEX_SECTORS (data_cnt)
+                 + (is_dir ? data_cnt : 0));
   bool success = (dir != NULL
                   && free_map_allocate (1, &inode_sector)
                   //&& inode_create (inode_sector, initial_size)
                   //&& dir_add (dir, name, inode_sector));
                   && inode_create (inode_sector, initial_size, is_dir)
-                  && dir_add (dir, file_name, inode_sector));
+                  && dir_add (dir, file_name, inode_sector, is_dir));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
+  journal_end ();
   dir_close (dir);
 
   return success;
@@ -114,7 +130,9 @@ filesys_remove (const char *name)
   split_path_filename(name, directory, file_name);
   struct dir *dir = dir_open_path (directory);
 
+  journal_begin (JOURNAL_OP_SECTORS);
   bool success = (dir != NULL && dir_remove (dir, file_name));
+  journal_end ();
 
   dir_close (dir); 
 
@@ -130,6 +148,7 @@ do_format (void)
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
   free_map_close ();
+  cache_flush ();
   printf ("done.\n");
 }
 
@@ -4,29 +4,93 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct lock free_map_lock;    /* Protects the free map. */
+static size_t free_cnt;              /* Number of free sectors. */
+static size_t reserved_cnt;          /* Free sectors promised to files. */
+
+static bool allocate (size_t cnt, disk_sector_t *sectorp, bool reserved);
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
+  lock_init (&free_map_lock);
   free_map = bitmap_create (disk_size (filesys_disk));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--disk is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTOR_CNT, true);
+  free_cnt = bitmap_count (free_map, 0, bitmap_size (free_map), false);
+  reserved_cnt = 0;
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  Sectors reserved with
+   free_map_reserve() are not available.
    Returns true if successful, false if all sectors were
    available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) 
 {
-  disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  return allocate (cnt, sectorp, false);
+}
+
+/* Allocates CNT consecutive sectors out of CNT sectors
+   previously reserved with free_map_reserve() and stores the
+   first into *SECTORP.  Returns true if successful, false if
+   there is no run of CNT free sectors, in which case the
+   reservation is untouched. */
+bool
+free_map_allocate_reserved (size_t cnt, disk_sector_t *sectorp) 
+{
+  return allocate (cnt, sectorp, true);
+}
+
+/* Sets aside CNT free sectors, so that later calls to
+   free_map_allocate_reserved() for that many sectors cannot run
+   out of space.  Returns true if successful, false if fewer than
+   CNT unreserved sectors are free. */
+bool
+free_map_reserve (size_t cnt) 
+{
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  success = free_cnt - reserved_cnt >= cnt;
+  if (success)
+    reserved_cnt += cnt;
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Gives back CNT reserved sectors that will not be allocated. */
+void
+free_map_unreserve (size_t cnt) 
+{
+  lock_acquire (&free_map_lock);
+  ASSERT (reserved_cnt >= cnt);
+  reserved_cnt -= cnt;
+  lock_release (&free_map_lock);
+}
+
+/* Allocates CNT consecutive sectors, from the reserved sectors
+   if RESERVED is true, otherwise from the rest, and stores the
+   first into *SECTORP.  Returns true if successful. */
+static bool
+allocate (size_t cnt, disk_sector_t *sectorp, bool reserved) 
+{
+  disk_sector_t sector = BITMAP_ERROR;
+
+  lock_acquire (&free_map_lock);
+  ASSERT (!reserved || reserved_cnt >= cnt);
+  if (reserved || free_cnt - reserved_cnt >= cnt)
+    sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
       && !bitmap_write (free_map, free_map_file))
@@ -35,7 +99,13 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp)
       sector = BITMAP_ERROR;
     }
   if (sector != BITMAP_ERROR)
-    *sectorp = sector;
+    {
+      *sectorp = sector;
+      free_cnt -= cnt;
+      if (reserved)
+        reserved_cnt -= cnt;
+    }
+  lock_release (&free_map_lock);
   return sector != BITMAP_ERROR;
 }
 
@@ -43,9 +113,12 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp)
 void
 free_map_release (disk_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
   bitmap_write (free_map, free_map_file);
+  free_cnt += cnt;
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -57,6 +130,7 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  free_cnt = bitmap_count (free_map, 0, bitmap_size (free_map), false);
 }
 
 /* Writes the free map to disk and closes the free map file. */
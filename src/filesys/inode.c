@@ -1,4 +1,5 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
@@ -9,6 +10,10 @@
 #include "threads/malloc.h"
 #include "threads/synch.h"
 #include "filesys/cache.h"
+#include "filesys/journal.h"
+#ifdef USERPROG
+#include "userprog/process.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -16,6 +21,9 @@
 /* Amount of sector_t in block */
 #define BLOCK_CAP 128
 
+/* Most delayed blocks an inode buffers before allocating them. */
+#define DELAY_MAX 64
+
 /* On-disk inode.
    Must be exactly DISK_SECTOR_SIZE bytes long. */
 struct inode_disk
@@ -37,6 +45,15 @@ bytes_to_sectors (off_t size)
 
 struct indir_block{ disk_sector_t ptr[BLOCK_CAP]; };
 
+/* A block written past the allocated end of a file, held in
+   memory until the inode allocates disk space for it. */
+struct delay_block
+  {
+    struct hash_elem elem;              /* Element in inode's delayed table. */
+    size_t idx;                         /* Block index within the file. */
+    uint8_t data[DISK_SECTOR_SIZE];     /* Block contents. */
+  };
+
 /* In-memory inode. */
 struct inode 
   {
@@ -45,10 +62,45 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned version;                   /* Incremented by every write. */
     struct inode_disk data;             /* Inode content. */
-    struct lock inode_lock;
+    struct lock inode_lock;             /* Guards allocation, DELAYED and
+                                           RESERVED. */
+    struct lock range_lock;             /* Guards RANGES. */
+    struct condition range_cond;        /* Signaled when a range is freed. */
+    struct list ranges;                 /* Byte ranges currently locked. */
+    struct lock dir_lock;               /* Serializes directory updates. */
+    size_t alloc_cnt;                   /* Data sectors allocated on disk. */
+    off_t disk_length;                  /* Length last written to disk. */
+    struct hash delayed;                /* Unallocated dirty blocks, by idx. */
+    size_t reserved;                    /* Free-map sectors reserved. */
+  };
+
+/* Returns the number of sectors, data and indirect, needed to
+   grow a file from START to END allocated data sectors. */
+static size_t
+sectors_needed (size_t start, size_t end)
+{
+  return (end - start
+          + DIV_ROUND_UP (end, BLOCK_CAP) - DIV_ROUND_UP (start, BLOCK_CAP));
+}
+
+/* A byte range of an inode locked by one reader or writer.
+   Readers of overlapping ranges share; a writer excludes every
+   overlapping range.  A write that extends the file locks
+   everything from its offset to RANGE_EOF, so extension is atomic
+   with respect to anyone touching bytes at or past end of file. */
+struct inode_range
+  {
+    struct list_elem elem;              /* Element in inode's range list. */
+    off_t start;                        /* First locked byte. */
+    off_t end;                          /* One past the last locked byte. */
+    bool write;                         /* Exclusive if true. */
   };
 
+/* End of a range that covers end of file, however it grows. */
+#define RANGE_EOF INT32_MAX
+
 /* Returns the disk sector that contains byte offset POS within
    INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -58,35 +110,43 @@ byte_to_sector (const struct inode *inode, off_t pos)
 {
   ASSERT (inode != NULL);
   size_t index1, index2;
-  if( pos < inode_length(inode) ){
-    struct indir_block* level1 = (struct indir_block*)malloc(sizeof(struct indir_block));
-    struct indir_block* level2 = (struct indir_block*)malloc(sizeof(struct indir_block));
-    if( level1 == NULL ) return -1;
-    if( level2 == NULL ){
-      free(level1);
-      return -1;
-    }
+  if( pos < inode_length(inode)
+      && (size_t) pos / DISK_SECTOR_SIZE < inode->alloc_cnt ){
+    disk_sector_t level2, result;
     index1 = ( pos / DISK_SECTOR_SIZE ) / BLOCK_CAP;
     index2 = ( pos / DISK_SECTOR_SIZE ) % BLOCK_CAP;
-    disk_read (filesys_disk, inode->data.start, level1);
-    disk_read (filesys_disk, level1->ptr[index1], level2);
-    disk_sector_t result = level2->ptr[index2];
-    free(level1);
-    free(level2);
+    cache_read (inode->data.start, &level2, index1 * sizeof level2,
+                sizeof level2);
+    cache_read (level2, &result, index2 * sizeof result, sizeof result);
     return result;
   }
   else return -1;
 }
 
+/* Returns true if INODE holds file system metadata, whose
+   writes must go through the journal. */
+static bool
+inode_is_metadata (const struct inode *inode)
+{
+  return inode->data.is_dir || inode->sector == FREE_MAP_SECTOR;
+}
+
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
+static struct lock open_inodes_lock;    /* Guards OPEN_INODES, open counts. */
+
+static bool inode_is_dirty (const struct inode *);
+static hash_hash_func delay_hash;
+static hash_less_func delay_less;
+static hash_action_func delay_free;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -130,22 +190,27 @@ inode_create (disk_sector_t sector, off_t length, bool is_dir)
     if( !free_map_allocate (1, &level2->ptr[i%BLOCK_CAP]) )
       return false; // allocate data sector
     static char zeros[DISK_SECTOR_SIZE];
-    disk_write (filesys_disk, level2->ptr[i%BLOCK_CAP], zeros);
+    /* A directory's sectors are metadata, and must never be
+       reachable after a crash without their zeros. */
+    if (is_dir)
+      journal_write (level2->ptr[i%BLOCK_CAP], zeros, 0, DISK_SECTOR_SIZE);
+    else
+      cache_write (level2->ptr[i%BLOCK_CAP], zeros, 0, DISK_SECTOR_SIZE);
     // write data to disk
     if( i % BLOCK_CAP == BLOCK_CAP-1 ){
-      disk_write(filesys_disk, level1->ptr[i/BLOCK_CAP], level2 );
+      journal_write (level1->ptr[i/BLOCK_CAP], level2, 0, DISK_SECTOR_SIZE);
       //write level 2 to disk
       memset( level2, 0, sizeof(struct indir_block) );
       //memset level 2 to zero
     }
   }
   if( i % BLOCK_CAP != 0 ){
-    disk_write(filesys_disk, level1->ptr[i/BLOCK_CAP], level2 );
+    journal_write (level1->ptr[i/BLOCK_CAP], level2, 0, DISK_SECTOR_SIZE);
     //write remain level 2 to disk
   }
-  disk_write (filesys_disk, disk_inode->start, level1);
+  journal_write (disk_inode->start, level1, 0, DISK_SECTOR_SIZE);
   // write level 1 to disk
-  disk_write (filesys_disk, sector, disk_inode);
+  journal_write (sector, disk_inode, 0, DISK_SECTOR_SIZE);
   // write inode_disk to disk
   free(disk_inode);
   free(level1);
@@ -161,6 +226,7 @@ inode_open (disk_sector_t sector)
 {
   struct list_elem *e;
   struct inode *inode;
+  lock_acquire (&open_inodes_lock);
   /* Check whether this inode is already open. */
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
        e = list_next (e)) 
@@ -168,7 +234,8 @@ inode_open (disk_sector_t sector)
       inode = list_entry (e, struct inode, elem);
       if (inode->sector == sector) 
         {
-          inode_reopen (inode);
+          inode->open_cnt++;
+          lock_release (&open_inodes_lock);
           return inode; 
         }
     }
@@ -176,16 +243,35 @@ inode_open (disk_sector_t sector)
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
+
+  if (!hash_init (&inode->delayed, delay_hash, delay_less, NULL))
+    {
+      free (inode);
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
   /* Initialize. */
   list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->version = 0;
   inode->removed = false;
   lock_init(&inode->inode_lock);
-  disk_read (filesys_disk, inode->sector, &inode->data);
+  lock_init (&inode->range_lock);
+  cond_init (&inode->range_cond);
+  list_init (&inode->ranges);
+  lock_init (&inode->dir_lock);
+  inode->reserved = 0;
+  cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+  inode->alloc_cnt = bytes_to_sectors (inode->data.length);
+  inode->disk_length = inode->data.length;
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -194,7 +280,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -215,10 +305,32 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
+  /* As the last opener, give delayed blocks their disk space and
+     write the length, unless nobody will ever read them again.
+     INODE stays on the open list meanwhile, so that a concurrent
+     inode_open() shares it instead of reading a stale on-disk
+     inode.  Such an opener may write more before we get the lock
+     back, so check again. */
+  lock_acquire (&open_inodes_lock);
+  while (inode->open_cnt == 1 && !inode->removed && inode_is_dirty (inode))
+    {
+      bool flushed;
+
+      lock_release (&open_inodes_lock);
+      flushed = inode_flush (inode);
+      lock_acquire (&open_inodes_lock);
+      if (!flushed)
+        break;
+    }
+
   /* Release resources if this was the last opener. */
   if (--inode->open_cnt == 0){
     /* Remove from inode list and release lock. */
     list_remove (&inode->elem);
+    lock_release (&open_inodes_lock);
+
+    hash_destroy (&inode->delayed, delay_free);
+    free_map_unreserve (inode->reserved);
 
     /* Deallocate blocks if removed. */
     if (inode->removed){
@@ -231,10 +343,12 @@ inode_close (struct inode *inode)
         return;
       }
 
-      disk_read (filesys_disk, inode->data.start, level1);
-      for( i = 0 ; i < bytes_to_sectors( inode_length(inode) ); i++){
+      /* Freeing blocks rewrites only the free map. */
+      journal_begin (0);
+      cache_read (inode->data.start, level1, 0, DISK_SECTOR_SIZE);
+      for( i = 0 ; i < inode->alloc_cnt; i++){
         if( i % BLOCK_CAP == 0  )
-          disk_read (filesys_disk, level1->ptr[i / BLOCK_CAP], level2);
+          cache_read (level1->ptr[i / BLOCK_CAP], level2, 0, DISK_SECTOR_SIZE);
         free_map_release (level2->ptr[i % BLOCK_CAP], 1);
         if( i % BLOCK_CAP == BLOCK_CAP - 1 ){
           free_map_release (level1->ptr[i / BLOCK_CAP], 1);
@@ -246,9 +360,14 @@ inode_close (struct inode *inode)
       // Deallocate remain block
       free_map_release (inode->data.start, 1);
       free_map_release (inode->sector, 1);
+      journal_end ();
+      free(level1);
+      free(level2);
     }
     free (inode); 
   }
+  else
+    lock_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -258,6 +377,85 @@ inode_remove (struct inode *inode)
 {
   ASSERT (inode != NULL);
   inode->removed = true;
+#ifdef USERPROG
+  process_forget_image (inode);
+#endif
+}
+
+/* Locks bytes [START, END) of INODE for reading, or for writing
+   if WRITE is true, sleeping until no conflicting range is held.
+   R is caller-provided storage for the range. */
+static void
+range_acquire (struct inode *inode, struct inode_range *r,
+               off_t start, off_t end, bool write)
+{
+  struct list_elem *e;
+
+  r->start = start;
+  r->end = end;
+  r->write = write;
+
+  lock_acquire (&inode->range_lock);
+ retry:
+  for (e = list_begin (&inode->ranges); e != list_end (&inode->ranges);
+       e = list_next (e))
+    {
+      struct inode_range *held = list_entry (e, struct inode_range, elem);
+      if (held->start < end && start < held->end
+          && (write || held->write))
+        {
+          cond_wait (&inode->range_cond, &inode->range_lock);
+          goto retry;
+        }
+    }
+  list_push_back (&inode->ranges, &r->elem);
+  lock_release (&inode->range_lock);
+}
+
+/* Unlocks range R of INODE. */
+static void
+range_release (struct inode *inode, struct inode_range *r)
+{
+  lock_acquire (&inode->range_lock);
+  list_remove (&r->elem);
+  cond_broadcast (&inode->range_cond, &inode->range_lock);
+  lock_release (&inode->range_lock);
+}
+
+/* Returns INODE's delayed block with index IDX, or a null
+   pointer if there is none. */
+static struct delay_block *
+delay_find (struct inode *inode, size_t idx)
+{
+  struct delay_block key;
+  struct hash_elem *e;
+
+  key.idx = idx;
+  e = hash_find (&inode->delayed, &key.elem);
+  return e != NULL ? hash_entry (e, struct delay_block, elem) : NULL;
+}
+
+/* Returns a hash value for delayed block E. */
+static unsigned
+delay_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct delay_block, elem)->idx);
+}
+
+/* Returns true if delayed block A precedes delayed block B. */
+static bool
+delay_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct delay_block, elem)->idx
+          < hash_entry (b, struct delay_block, elem)->idx);
+}
+
+/* Frees delayed block E.  A hash_action_func for inode_close(). */
+static void
+delay_free (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct delay_block, elem));
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -267,7 +465,9 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset){
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
+  struct inode_range range;
 
+  range_acquire (inode, &range, offset, offset + size, false);
   while (size > 0){
     /* Disk sector to read, starting byte offset within sector. */
     disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -275,7 +475,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset){
 
     /* Bytes left in inode, bytes left in sector, lesser of the two. */
     off_t inode_left = inode_length (inode) - offset;
-    if( inode_left < 0 ) return bytes_read;
+    if( inode_left < 0 ) break;
     int sector_left = DISK_SECTOR_SIZE - sector_ofs;
     int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -284,87 +484,321 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset){
     if (chunk_size <= 0)
       break;
     
-    cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+    if (sector_idx != (disk_sector_t) -1)
+      cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+    else
+      {
+        /* Not allocated yet: a delayed block, or a hole. */
+        struct delay_block *d;
+
+        lock_acquire (&inode->inode_lock);
+        d = delay_find (inode, offset / DISK_SECTOR_SIZE);
+        if (d != NULL)
+          memcpy (buffer + bytes_read, d->data + sector_ofs, chunk_size);
+        else
+          memset (buffer + bytes_read, 0, chunk_size);
+        lock_release (&inode->inode_lock);
+      }
 
     /* Advance. */
     size -= chunk_size;
     offset += chunk_size;
     bytes_read += chunk_size;
   }
+  range_release (inode, &range);
   return bytes_read;
 }
 
+/* Returns true if INODE has bytes without disk space or a length
+   that has not reached the disk. */
+static bool
+inode_is_dirty (const struct inode *inode)
+{
+  return (inode->alloc_cnt < bytes_to_sectors (inode->data.length)
+          || inode->disk_length != inode->data.length);
+}
+
+/* Writes INODE's on-disk inode through the journal, if its length
+   has changed.  The on-disk length never covers unallocated
+   sectors, while the in-memory length keeps counting delayed
+   bytes.  Must be called inside a journal operation with INODE's
+   lock held. */
+static void
+inode_write_disk (struct inode *inode)
+{
+  off_t length = inode->data.length;
+  off_t allocated = (off_t) inode->alloc_cnt * DISK_SECTOR_SIZE;
+
+  ASSERT (lock_held_by_current_thread (&inode->inode_lock));
+  if (length > allocated)
+    inode->data.length = allocated;
+  if (inode->data.length != inode->disk_length)
+    {
+      journal_write (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+      inode->disk_length = inode->data.length;
+    }
+  inode->data.length = length;
+}
 
+/* Allocates disk space for INODE up to LENGTH bytes.  The new data
+   sectors are taken as one contiguous extent when the free map
+   has one, and filled from INODE's delayed blocks, or zeros where
+   nothing was written.  A metadata inode's zeros go through the
+   journal along with the index blocks that point to them.  A
+   regular file takes the sectors out of the space it reserved
+   when it grew.  Must be called inside a journal operation with
+   INODE's lock held. */
 static bool inode_write_expand(struct inode *inode, off_t length){
-  // Expanding sequence
-  ASSERT( inode_length(inode) < length );
-  int i = (inode_length(inode)-1) / DISK_SECTOR_SIZE + 1;
-  if(inode_length(inode) == 0) i = 0;
+  static char zeros[DISK_SECTOR_SIZE];
+  size_t i = inode->alloc_cnt;
+  size_t end = bytes_to_sectors (length);
   struct indir_block *level1;
   struct indir_block *level2;
+  disk_sector_t extent;
+  bool reserved = !inode_is_metadata (inode);
+  bool (*allocate) (size_t, disk_sector_t *)
+    = reserved ? free_map_allocate_reserved : free_map_allocate;
+  size_t start = i;
+  bool contiguous, success = true;
+
+  ASSERT (lock_held_by_current_thread (&inode->inode_lock));
+  if (i >= end){
+    if (inode->data.length < length)
+      inode->data.length = length;
+    inode_write_disk (inode);
+    return true;
+  }
 
   level1 = (struct indir_block*)malloc(sizeof(struct indir_block));
-  level2 = (struct indir_block*)malloc(sizeof(struct indir_block));
+  level2 = (struct indir_block*)calloc(1, sizeof(struct indir_block));
   if( level1 == NULL ) return false;
   else if( level2 == NULL ){
     free(level1);
     return false;
   }
-  disk_read(filesys_disk, inode->data.start, level1);
+  cache_read (inode->data.start, level1, 0, DISK_SECTOR_SIZE);
   if( i % BLOCK_CAP != 0){
-    disk_read(filesys_disk, level1->ptr[i/BLOCK_CAP], level2);
+    cache_read (level1->ptr[i/BLOCK_CAP], level2, 0, DISK_SECTOR_SIZE);
   }
 
-  for( ; i < (length-1)/DISK_SECTOR_SIZE + 1; i++ ){
+  /* One extent for the whole range keeps the file contiguous. */
+  contiguous = allocate (end - i, &extent);
+
+  for( ; i < end; i++ ){
+    struct delay_block *d;
+
     if ( i % BLOCK_CAP == 0 ){
-      if(!free_map_allocate (1, &level1->ptr[i/BLOCK_CAP]) )
-        return false; // allocate second level inode ptr
+      if(!allocate (1, &level1->ptr[i/BLOCK_CAP]) ){
+        success = false;
+        break; // allocate second level inode ptr
+      }
     }
-    if( !free_map_allocate (1, &level2->ptr[i%BLOCK_CAP]) )
-      return false; // allocate data sector
-    static char zeros[DISK_SECTOR_SIZE];
-    disk_write (filesys_disk, level2->ptr[i%BLOCK_CAP], zeros);
+    if (contiguous)
+      level2->ptr[i%BLOCK_CAP] = extent + (i - inode->alloc_cnt);
+    else if( !allocate (1, &level2->ptr[i%BLOCK_CAP]) ){
+      if( i % BLOCK_CAP == 0 )
+        free_map_release (level1->ptr[i/BLOCK_CAP], 1);
+      success = false;
+      break; // allocate data sector
+    }
+
+    d = delay_find (inode, i);
+    if (d != NULL){
+      cache_write (level2->ptr[i%BLOCK_CAP], d->data, 0, DISK_SECTOR_SIZE);
+      hash_delete (&inode->delayed, &d->elem);
+      free (d);
+    }
+    else if (!reserved)
+      journal_write (level2->ptr[i%BLOCK_CAP], zeros, 0, DISK_SECTOR_SIZE);
+    else
+      cache_write (level2->ptr[i%BLOCK_CAP], zeros, 0, DISK_SECTOR_SIZE);
     // write data to disk
     if( i % BLOCK_CAP == BLOCK_CAP-1 ){
-      disk_write(filesys_disk, level1->ptr[i/BLOCK_CAP], level2 );
+      journal_write (level1->ptr[i/BLOCK_CAP], level2, 0, DISK_SECTOR_SIZE);
       //write level 2 to disk
       memset( level2, 0, sizeof(struct indir_block) );
       //memset level 2 to zero
     }
   }
+  if (!success && contiguous)
+    free_map_release (extent + (i - inode->alloc_cnt), end - i);
+  if (reserved)
+    {
+      /* Allocating from the reservation cannot run out of space,
+         only the contiguous attempt can fail. */
+      ASSERT (success);
+      inode->reserved -= sectors_needed (start, end);
+    }
   if( i % BLOCK_CAP != 0 ){
-    disk_write(filesys_disk, level1->ptr[i/BLOCK_CAP], level2 );
+    journal_write (level1->ptr[i/BLOCK_CAP], level2, 0, DISK_SECTOR_SIZE);
     //write remain level 2 to disk
   }
-  disk_write (filesys_disk, inode->data.start, level1);
+  journal_write (inode->data.start, level1, 0, DISK_SECTOR_SIZE);
   // write level 1 to disk
-  inode->data.length = length;
-  disk_write (filesys_disk, inode->sector, &inode->data);
+
+  /* Only a directory or the free map can run out of space here,
+     and inode_write_at() then fails the write. */
+  off_t logical = inode->data.length > length ? inode->data.length : length;
+  off_t allocated = (off_t) i * DISK_SECTOR_SIZE;
+  inode->alloc_cnt = i;
+  inode->data.length = success || logical < allocated ? logical : allocated;
+  inode_write_disk (inode);
   // write inode_disk to disk
   free(level1);
   free(level2);
+  return success;
+}
+
+/* Allocates disk space for every delayed block of INODE, as one
+   contiguous extent where possible, and writes INODE's length to
+   disk if it has changed, as it does when an append stays inside
+   the last allocated sector.  Called when the delayed table
+   fills up, when the last opener closes INODE and at shutdown.
+   The space was reserved when INODE grew, so this fails only if
+   memory is short. */
+bool
+inode_flush (struct inode *inode)
+{
+  bool success = true;
+  struct inode_range range;
+  off_t length = inode_length (inode);
+  size_t alloc_cnt = inode->alloc_cnt;
+  size_t new_cnt = bytes_to_sectors (length);
+
+  if (!inode_is_dirty (inode))
+    return true;
+
+  /* Readers must not see a block between the delayed list and
+     the disk, so exclude them while moving it.  Blocks written
+     after LENGTH was read wait for the next flush, so that the
+     journal reservation covers everything allocated here. */
+  journal_begin (JOURNAL_OP_SECTORS
+                 + JOURNAL_INDEX_SECTORS (new_cnt > alloc_cnt
+                                          ? new_cnt - alloc_cnt : 0));
+  range_acquire (inode, &range, 0, RANGE_EOF, true);
+  lock_acquire (&inode->inode_lock);
+  if (inode_is_dirty (inode))
+    success = inode_write_expand (inode, length);
+  lock_release (&inode->inode_lock);
+  range_release (inode, &range);
+  journal_end ();
+  return success;
+}
+
+/* Flushes the delayed blocks of every open inode.  Each inode is
+   reopened under open_inodes_lock and flushed after releasing it,
+   since flushing waits on the journal, which may be waiting on a
+   thread that needs open_inodes_lock. */
+void
+inode_flush_all (void)
+{
+  struct inode **inodes;
+  struct list_elem *e;
+  size_t cnt = 0, i;
+
+  lock_acquire (&open_inodes_lock);
+  inodes = malloc (list_size (&open_inodes) * sizeof *inodes);
+  if (inodes == NULL)
+    {
+      lock_release (&open_inodes_lock);
+      return;
+    }
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e))
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      inodes[cnt++] = inode;
+    }
+  lock_release (&open_inodes_lock);
+
+  for (i = 0; i < cnt; i++)
+    {
+      inode_flush (inodes[i]);
+      inode_close (inodes[i]);
+    }
+  free (inodes);
+}
+
+/* Copies CHUNK_SIZE bytes from BUFFER into the delayed block IDX
+   of INODE at SECTOR_OFS, creating the block if needed.  Returns
+   false if memory is exhausted. */
+static bool
+delay_write (struct inode *inode, size_t idx, const uint8_t *buffer,
+             int sector_ofs, int chunk_size)
+{
+  struct delay_block *d;
+
+  lock_acquire (&inode->inode_lock);
+  d = delay_find (inode, idx);
+  if (d == NULL){
+    d = calloc (1, sizeof *d);
+    if (d == NULL){
+      lock_release (&inode->inode_lock);
+      return false;
+    }
+    d->idx = idx;
+    hash_insert (&inode->delayed, &d->elem);
+  }
+  memcpy (d->data + sector_ofs, buffer, chunk_size);
+  lock_release (&inode->inode_lock);
   return true;
 }
 
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if an error occurs.
+   Writes past end of file extend the inode.  For regular files
+   the new blocks stay in memory until inode_flush() allocates
+   them; metadata inodes are extended right away. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
+  struct inode_range range;
+  bool extending, journaled;
   if (inode->deny_write_cnt)
     return 0;
+
+  /* Join the journal before taking INODE's locks, since waiting
+     for a commit while holding them could deadlock.  Besides the
+     written sectors, the new ones are zero-filled through it. */
+  extending = (size + offset) > inode_length (inode);
+  journaled = extending && inode_is_metadata (inode);
+  if (journaled)
+    {
+      size_t new_cnt = bytes_to_sectors (size + offset) - inode->alloc_cnt;
+      journal_begin (JOURNAL_OP_SECTORS + JOURNAL_INDEX_SECTORS (new_cnt)
+                     + new_cnt + bytes_to_sectors (size) + 1);
+    }
+  range_acquire (inode, &range, offset,
+                 extending ? RANGE_EOF : offset + size, true);
   
   if ( (size + offset) > inode_length(inode)){
     lock_acquire(&inode->inode_lock);
-    if( !inode_write_expand(inode, size+offset) ){
+    if (!inode_is_metadata (inode)){
+      /* Reserve disk space for the new blocks now, so that a full
+         disk fails this write rather than the later flush. */
+      if ((size + offset) > inode_length (inode)){
+        size_t need = sectors_needed (bytes_to_sectors (inode_length (inode)),
+                                      bytes_to_sectors (size + offset));
+        if (!free_map_reserve (need)){
+          lock_release(&inode->inode_lock);
+          range_release (inode, &range);
+          return 0;
+        }
+        inode->reserved += need;
+        inode->data.length = size + offset;
+      }
+    }
+    else if( !inode_write_expand(inode, size+offset) ){
       lock_release(&inode->inode_lock);
+      range_release (inode, &range);
+      if (journaled)
+        journal_end ();
       return 0;
     }
     lock_release(&inode->inode_lock);
@@ -386,13 +820,29 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
     if (chunk_size <= 0)
       break;
 
-    cache_write (sector_idx, (void*) buffer + bytes_written, sector_ofs, chunk_size);
+    if (sector_idx == (disk_sector_t) -1){
+      if (!delay_write (inode, offset / DISK_SECTOR_SIZE,
+                        buffer + bytes_written, sector_ofs, chunk_size))
+        break;
+    }
+    else if (inode_is_metadata (inode))
+      journal_write (sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
+    else
+      cache_write (sector_idx, (void*) buffer + bytes_written, sector_ofs, chunk_size);
 
     /* Advance. */
     size -= chunk_size;
     offset += chunk_size;
     bytes_written += chunk_size;
   }
+  if (bytes_written > 0)
+    inode->version++;
+  range_release (inode, &range);
+  if (journaled)
+    journal_end ();
+
+  if (hash_size (&inode->delayed) >= DELAY_MAX)
+    inode_flush (inode);
 
   return bytes_written;
 }
@@ -402,8 +852,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&open_inodes_lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&open_inodes_lock);
 }
 
 /* Re-enables writes to INODE.
@@ -412,9 +864,19 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&open_inodes_lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&open_inodes_lock);
+}
+
+/* Returns INODE's version, which changes whenever INODE is
+   written, for as long as INODE stays open. */
+unsigned
+inode_version (const struct inode *inode)
+{
+  return inode->version;
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -430,3 +892,19 @@ inode_is_directory (const struct inode *inode)
   return inode->data.is_dir;
 }
 
+/* Acquires the lock that serializes updates to directory INODE,
+   so that checking for a name and adding or removing it happen
+   atomically. */
+void
+inode_dir_lock (struct inode *inode)
+{
+  ASSERT (inode_is_directory (inode));
+  lock_acquire (&inode->dir_lock);
+}
+
+/* Releases the lock acquired by inode_dir_lock(). */
+void
+inode_dir_unlock (struct inode *inode)
+{
+  lock_release (&inode->dir_lock);
+}
@@ -0,0 +1,316 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Write-ahead journal for file system metadata.
+
+   Every metadata sector (inodes, indirect blocks, directory
+   contents and the free map) modified between journal_begin()
+   and journal_end() joins the running transaction.  Its cache
+   entry is pinned so that it cannot reach its home sector
+   early.  When the last outstanding operation ends, the whole
+   transaction is written to the log as one sequential run:
+
+        descriptor | sector 0 | sector 1 | ... | commit record
+
+   and the cache entries are unpinned.  Home sectors are then
+   written back lazily by the buffer cache.  Once the log fills
+   up, a checkpoint flushes the cache and restarts the log.
+
+   At mount time, every committed transaction still in the log
+   is replayed, so recovery costs at most JOURNAL_LOG_SECTORS
+   reads and writes. */
+
+/* Identifies the journal header, descriptor and commit blocks. */
+#define JOURNAL_MAGIC 0x4a524e4c
+#define DESC_MAGIC 0x4a445343
+#define COMMIT_MAGIC 0x4a434d54
+
+/* First log sector. */
+#define LOG_START (JOURNAL_SECTOR + 1)
+
+/* Sector numbers that fit in one descriptor block. */
+#define DESC_CAP 125
+
+/* Most sectors in a single transaction.  An operation that may
+   need more runs alone and is committed in pieces. */
+#define TXN_MAX 60
+
+/* On-disk journal header.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* Magic number. */
+    uint32_t seq;                       /* Sequence of first logged txn. */
+    uint32_t unused[126];               /* Not used. */
+  };
+
+/* On-disk descriptor or commit block.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_block
+  {
+    unsigned magic;                     /* DESC_MAGIC or COMMIT_MAGIC. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t cnt;                       /* Number of logged sectors. */
+    disk_sector_t sectors[DESC_CAP];    /* Home sectors, descriptor only. */
+  };
+
+static struct lock journal_lock;        /* Protects everything below. */
+static struct condition journal_cond;   /* Signaled when an op ends. */
+static int outstanding;                 /* Operations in the running txn. */
+static size_t reserved;                 /* Sectors they reserved. */
+static size_t free_map_sectors;         /* Sectors in the free map file. */
+
+static disk_sector_t txn[TXN_MAX];      /* Sectors in the running txn. */
+static size_t txn_cnt;                  /* Number of entries in TXN. */
+
+static uint32_t seq;                    /* Sequence of the running txn. */
+static size_t log_pos;                  /* Next free log sector. */
+
+static void commit (void);
+static void checkpoint (void);
+static void write_header (void);
+
+/* Initializes the journal.  If FORMAT is true, starts an empty
+   log; otherwise replays every committed transaction left in
+   the log by an unclean shutdown. */
+void
+journal_init (bool format)
+{
+  struct journal_header *h;
+  struct journal_block *b;
+  uint8_t *buf;
+  int replayed = 0;
+
+  ASSERT (sizeof (struct journal_header) == DISK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_block) == DISK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  cond_init (&journal_cond);
+  outstanding = 0;
+  reserved = 0;
+  free_map_sectors = DIV_ROUND_UP (disk_size (filesys_disk),
+                                   DISK_SECTOR_SIZE * 8) + 1;
+  txn_cnt = 0;
+  seq = 1;
+  log_pos = 0;
+
+  if (format)
+    {
+      write_header ();
+      return;
+    }
+
+  h = malloc (sizeof *h);
+  b = malloc (sizeof *b);
+  buf = malloc (DISK_SECTOR_SIZE);
+  if (h == NULL || b == NULL || buf == NULL)
+    PANIC ("journal recovery failed--out of memory");
+
+  disk_read (filesys_disk, JOURNAL_SECTOR, h);
+  if (h->magic == JOURNAL_MAGIC)
+    {
+      seq = h->seq;
+      while (log_pos + 2 <= JOURNAL_LOG_SECTORS)
+        {
+          size_t i, cnt;
+
+          /* Stop at the first transaction without a matching
+             descriptor and commit record. */
+          disk_read (filesys_disk, LOG_START + log_pos, b);
+          cnt = b->cnt;
+          if (b->magic != DESC_MAGIC || b->seq != seq || cnt > DESC_CAP
+              || log_pos + cnt + 2 > JOURNAL_LOG_SECTORS)
+            break;
+          memcpy (buf, b, DISK_SECTOR_SIZE);
+          disk_read (filesys_disk, LOG_START + log_pos + cnt + 1, b);
+          if (b->magic != COMMIT_MAGIC || b->seq != seq || b->cnt != cnt)
+            break;
+
+          /* Replay. */
+          memcpy (b, buf, DISK_SECTOR_SIZE);
+          for (i = 0; i < cnt; i++)
+            {
+              disk_read (filesys_disk, LOG_START + log_pos + 1 + i, buf);
+              disk_write (filesys_disk, b->sectors[i], buf);
+            }
+          log_pos += cnt + 2;
+          seq++;
+          replayed++;
+        }
+    }
+  if (replayed > 0)
+    printf ("journal: replayed %d transaction(s)\n", replayed);
+
+  free (h);
+  free (b);
+  free (buf);
+
+  log_pos = 0;
+  write_header ();
+}
+
+/* Checkpoints the journal, writing all committed metadata to
+   its home sectors. */
+void
+journal_done (void)
+{
+  lock_acquire (&journal_lock);
+  checkpoint ();
+  lock_release (&journal_lock);
+}
+
+/* Starts a file system operation whose metadata updates must
+   reach the disk atomically.  CNT is the most metadata sectors,
+   not counting the free map, that the operation may write; the
+   whole free map is always reserved too.  Calls may nest; only
+   the outermost call reserves room in the running transaction,
+   so it must account for the nested ones.
+
+   An operation waits until its reservation fits in the running
+   transaction alongside the others.  One too big to fit at all
+   waits until no other operation is running, then runs alone. */
+void
+journal_begin (size_t cnt)
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth++ > 0)
+    return;
+
+  cnt += free_map_sectors;
+  lock_acquire (&journal_lock);
+  while (outstanding > 0 && txn_cnt + reserved + cnt > TXN_MAX)
+    cond_wait (&journal_cond, &journal_lock);
+  outstanding++;
+  reserved += cnt;
+  t->journal_reserved = cnt;
+  lock_release (&journal_lock);
+}
+
+/* Ends an operation started with journal_begin().  The running
+   transaction commits once no operation is left in it, so
+   concurrent operations are grouped into a single log write. */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (outstanding > 0);
+  reserved -= t->journal_reserved;
+  if (--outstanding == 0)
+    commit ();
+  cond_broadcast (&journal_cond, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Writes SIZE bytes from BUFFER into metadata sector SECTOR,
+   starting at byte OFS within the sector.  Inside an operation
+   the sector joins the running transaction; otherwise (e.g.
+   while formatting) it is written through the cache directly. */
+void
+journal_write (disk_sector_t sector, const void *buffer, int ofs, int size)
+{
+  if (thread_current ()->journal_depth > 0)
+    {
+      size_t i;
+
+      lock_acquire (&journal_lock);
+      for (i = 0; i < txn_cnt; i++)
+        if (txn[i] == sector)
+          break;
+      if (i == txn_cnt)
+        {
+          if (txn_cnt == TXN_MAX)
+            {
+              /* Only an operation too big for one transaction,
+                 which runs alone, gets here.  Commit what it has
+                 done so far and carry on in a fresh transaction;
+                 such an operation is not atomic as a whole. */
+              ASSERT (outstanding == 1);
+              commit ();
+            }
+          txn[txn_cnt++] = sector;
+          cache_set_pinned (sector, true);
+        }
+      lock_release (&journal_lock);
+    }
+  cache_write (sector, (void *) buffer, ofs, size);
+}
+
+/* Writes the running transaction to the log and releases its
+   cache entries for lazy write-back. */
+static void
+commit (void)
+{
+  static struct journal_block b;
+  static uint8_t buf[DISK_SECTOR_SIZE];
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  if (txn_cnt == 0)
+    return;
+
+  /* Descriptor, logged sectors, then the commit record. */
+  memset (&b, 0, sizeof b);
+  b.magic = DESC_MAGIC;
+  b.seq = seq;
+  b.cnt = txn_cnt;
+  memcpy (b.sectors, txn, txn_cnt * sizeof *txn);
+  disk_write (filesys_disk, LOG_START + log_pos, &b);
+  for (i = 0; i < txn_cnt; i++)
+    {
+      cache_read (txn[i], buf, 0, DISK_SECTOR_SIZE);
+      disk_write (filesys_disk, LOG_START + log_pos + 1 + i, buf);
+    }
+  memset (&b, 0, sizeof b);
+  b.magic = COMMIT_MAGIC;
+  b.seq = seq;
+  b.cnt = txn_cnt;
+  disk_write (filesys_disk, LOG_START + log_pos + txn_cnt + 1, &b);
+
+  for (i = 0; i < txn_cnt; i++)
+    cache_set_pinned (txn[i], false);
+  log_pos += txn_cnt + 2;
+  txn_cnt = 0;
+  seq++;
+
+  /* Make sure the next transaction fits. */
+  if (log_pos + TXN_MAX + 2 > JOURNAL_LOG_SECTORS)
+    checkpoint ();
+}
+
+/* Writes all committed sectors home and empties the log. */
+static void
+checkpoint (void)
+{
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  cache_flush ();
+  log_pos = 0;
+  write_header ();
+}
+
+/* Writes the journal header, marking SEQ as the first
+   transaction to replay. */
+static void
+write_header (void)
+{
+  static struct journal_header h;
+
+  memset (&h, 0, sizeof h);
+  h.magic = JOURNAL_MAGIC;
+  h.seq = seq;
+  disk_write (filesys_disk, JOURNAL_SECTOR, &h);
+}
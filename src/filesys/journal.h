@@ -0,0 +1,34 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <round.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+#include "filesys/filesys.h"
+
+/* Number of sectors in the circular log that follows the
+   journal header at JOURNAL_SECTOR. */
+#define JOURNAL_LOG_SECTORS 128
+
+/* Total number of sectors reserved for the journal. */
+#define JOURNAL_SECTOR_CNT (1 + JOURNAL_LOG_SECTORS)
+
+void journal_init (bool format);
+void journal_done (void);
+
+/* Most metadata sectors, besides the free map, written by an
+   operation that updates a few directory entries and inodes. */
+#define JOURNAL_OP_SECTORS 16
+
+/* Index sectors written when allocating or freeing DATA_CNT
+   data sectors of one file: its level-2 blocks, one more for a
+   partly filled first block, and its level-1 block. */
+#define JOURNAL_INDEX_SECTORS(DATA_CNT) \
+  (DIV_ROUND_UP (DATA_CNT, DISK_SECTOR_SIZE / sizeof (disk_sector_t)) + 2)
+
+void journal_begin (size_t cnt);
+void journal_end (void);
+void journal_write (disk_sector_t, const void *buffer, int ofs, int size);
+
+#endif /* filesys/journal.h */
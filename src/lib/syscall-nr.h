@@ -28,7 +28,119 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_STATS,                  /* Report kernel statistics. */
+    SYS_RING_SETUP,             /* Map a submission ring. */
+    SYS_RING_ENTER,             /* Run queued ring operations. */
+    SYS_TTYMODE,                /* Set console input mode. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_SHM_CREATE,             /* Create shared memory. */
+    SYS_SHM_ATTACH,             /* Map shared memory. */
+    SYS_SHM_DETACH,             /* Unmap shared memory. */
+    SYS_GETDENTS,               /* Read several directory entries. */
+    SYS_FORK                    /* Copy the current process. */
+  };
+
+/* One buffer of a readv() or writev() request. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    unsigned iov_len;           /* Length of buffer in bytes. */
+  };
+
+/* Maximum number of buffers in a readv() or writev() request. */
+#define IOV_MAX 1024
+
+/* One directory entry returned by getdents(). */
+struct dirent
+  {
+    int inumber;                /* Inode number. */
+    int is_dir;                 /* Nonzero if a directory. */
+    char name[16];              /* Null-terminated file name. */
+  };
+
+/* Console input modes for SYS_TTYMODE. */
+#define TTY_RAW 0               /* Return keys as soon as available. */
+#define TTY_CANON 1             /* Edit and echo a line at a time. */
+
+/* Kinds of statistics reported by SYS_STATS. */
+#define STATS_SYSCALLS 0        /* struct syscall_stat per call number. */
+#define STATS_VM 1              /* struct vm_stat for the calling process. */
+
+/* Statistics for one system call number. */
+struct syscall_stat
+  {
+    unsigned count;             /* Number of invocations. */
+    unsigned long long ticks;   /* Timer ticks spent in the kernel. */
+    unsigned long long cycles;  /* TSC cycles spent in the kernel. */
+  };
+
+/* Paging statistics for one process.  A page shared with other
+   processes counts as resident in each of them. */
+struct vm_stat
+  {
+    unsigned major_faults;      /* Faults that read a file or swap. */
+    unsigned minor_faults;      /* Faults resolved without I/O. */
+    unsigned evictions;         /* Pages taken away by eviction. */
+    unsigned long long swap_in_bytes;  /* Bytes read back from swap. */
+    unsigned long long swap_out_bytes; /* Bytes written to swap. */
+    unsigned resident_pages;    /* Pages now mapped to frames. */
+    unsigned peak_resident_pages; /* Most pages ever resident at once. */
+  };
+
+/* Submission ring shared between a process and the kernel.
+
+   The process queues operations in SQ by filling sq[sq_tail %
+   RING_ENTRIES] and incrementing sq_tail, then calls ring_enter()
+   to have the kernel run them in order.  For each operation the
+   kernel posts a completion to cq[cq_tail % RING_ENTRIES] and
+   increments cq_tail; the process reaps it and increments
+   cq_head.  All four counters run freely and wrap around. */
+#define RING_ENTRIES 64
+
+/* Ring operations. */
+enum ring_op
+  {
+    RING_NOP,                   /* Does nothing, result 0. */
+    RING_OPEN,                  /* open (buf), result is fd. */
+    RING_CLOSE,                 /* close (fd), result 0. */
+    RING_READ,                  /* read or pread, result is bytes. */
+    RING_WRITE                  /* write or pwrite, result is bytes. */
+  };
+
+/* Submission queue entry. */
+struct ring_sqe
+  {
+    int op;                     /* RING_* operation. */
+    int fd;                     /* File descriptor. */
+    void *buf;                  /* Buffer, or file name for RING_OPEN. */
+    unsigned len;               /* Buffer length in bytes. */
+    int offset;                 /* File offset, or -1 for file position. */
+    unsigned user_data;         /* Passed back in the completion. */
+  };
+
+/* Completion queue entry. */
+struct ring_cqe
+  {
+    unsigned user_data;         /* From the submission. */
+    int result;                 /* Operation's return value. */
+  };
+
+/* Submission ring, one page mapped by ring_setup(). */
+struct ring
+  {
+    unsigned sq_head;           /* Next submission the kernel runs. */
+    unsigned sq_tail;           /* Next submission the process fills. */
+    unsigned cq_head;           /* Next completion the process reaps. */
+    unsigned cq_tail;           /* Next completion the kernel posts. */
+    struct ring_sqe sq[RING_ENTRIES];
+    struct ring_cqe cq[RING_ENTRIES];
   };
 
 #endif /* lib/syscall-nr.h */
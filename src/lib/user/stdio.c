@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Buffered streams.
+
+   Each stream owns one BUFSIZ-byte buffer that holds either
+   pending output or input read ahead, never both.  stdout is
+   line buffered, so that each line reaches the console in a
+   single write() and complete lines are never lost if the
+   kernel kills the process.  Everything is flushed by exit().
+   There is no malloc() in user programs, so streams come from a
+   fixed table. */
+
+/* A stream. */
+struct FILE
+  {
+    bool in_use;                /* False if this slot is free. */
+    int fd;                     /* File descriptor. */
+    int mode;                   /* _IOFBF, _IOLBF, or _IONBF. */
+    bool writing;               /* Buffer holds output, not input. */
+    bool eof;                   /* Hit end of file. */
+    bool error;                 /* A read or write failed. */
+    char *buf;                  /* Buffer, BUFSIZ bytes. */
+    size_t pos;                 /* Next byte in buffer. */
+    size_t len;                 /* Bytes of input in buffer. */
+  };
+
+static char buffers[FOPEN_MAX][BUFSIZ];
+static struct FILE files[FOPEN_MAX] =
+  {
+    {true, STDIN_FILENO, _IOFBF, false, false, false, buffers[0], 0, 0},
+    {true, STDOUT_FILENO, _IOLBF, true, false, false, buffers[1], 0, 0},
+  };
+
+FILE *stdin = &files[0];
+FILE *stdout = &files[1];
+
+static void start_writing (FILE *);
+static bool start_reading (FILE *);
+static void vfprintf_helper (char, void *);
+
+/* Opens the file named NAME for buffered reading and writing.
+   Returns the new stream, or a null pointer on failure. */
+FILE *
+fopen (const char *name) 
+{
+  int fd = open (name);
+  FILE *stream;
+
+  if (fd < 0)
+    return NULL;
+  stream = fdopen (fd);
+  if (stream == NULL)
+    close (fd);
+  return stream;
+}
+
+/* Returns a new fully buffered stream for open file descriptor
+   FD, or a null pointer if too many streams are open. */
+FILE *
+fdopen (int fd) 
+{
+  int i;
+
+  for (i = 0; i < FOPEN_MAX; i++)
+    if (!files[i].in_use)
+      {
+        FILE *stream = &files[i];
+        stream->in_use = true;
+        stream->fd = fd;
+        stream->mode = _IOFBF;
+        stream->writing = false;
+        stream->eof = stream->error = false;
+        stream->buf = buffers[i];
+        stream->pos = stream->len = 0;
+        return stream;
+      }
+  return NULL;
+}
+
+/* Flushes STREAM, closes its file descriptor, and frees it.
+   Returns 0 if successful, EOF if the flush failed. */
+int
+fclose (FILE *stream) 
+{
+  int retval = fflush (stream);
+
+  close (stream->fd);
+  stream->in_use = false;
+  return retval;
+}
+
+/* Writes STREAM's buffered output to its file, or every open
+   stream's if STREAM is a null pointer.  Returns 0 if
+   successful, EOF on failure. */
+int
+fflush (FILE *stream) 
+{
+  if (stream == NULL) 
+    {
+      int retval = 0;
+      int i;
+
+      for (i = 0; i < FOPEN_MAX; i++)
+        if (files[i].in_use && fflush (&files[i]) == EOF)
+          retval = EOF;
+      return retval;
+    }
+
+  if (stream->writing && stream->pos > 0) 
+    {
+      int size = stream->pos;
+      stream->pos = 0;
+      if (write (stream->fd, stream->buf, size) != size) 
+        {
+          stream->error = true;
+          return EOF;
+        }
+    }
+  return 0;
+}
+
+/* Sets STREAM's buffering MODE to _IOFBF, _IOLBF, or _IONBF,
+   flushing any pending output first.  Returns 0 if successful,
+   nonzero on failure. */
+int
+setvbuf (FILE *stream, int mode) 
+{
+  if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+    return EOF;
+  if (fflush (stream) == EOF)
+    return EOF;
+  stream->mode = mode;
+  return 0;
+}
+
+/* Returns STREAM's file descriptor. */
+int
+fileno (FILE *stream) 
+{
+  return stream->fd;
+}
+
+/* Reads and returns the next byte from STREAM, or EOF at end of
+   file or on error. */
+int
+fgetc (FILE *stream) 
+{
+  unsigned char c;
+  return fread (&c, 1, 1, stream) == 1 ? c : EOF;
+}
+
+/* Reads a line of at most SIZE - 1 bytes, including any
+   new-line, from STREAM into S and null-terminates it.  Returns
+   S, or a null pointer if nothing could be read. */
+char *
+fgets (char *s, int size, FILE *stream) 
+{
+  int i = 0;
+
+  if (size <= 0)
+    return NULL;
+  while (i < size - 1) 
+    {
+      int c = fgetc (stream);
+      if (c == EOF)
+        break;
+      s[i++] = c;
+      if (c == '\n')
+        break;
+    }
+  if (i == 0)
+    return NULL;
+  s[i] = '\0';
+  return s;
+}
+
+/* Reads up to CNT items of SIZE bytes each from STREAM into
+   BUFFER.  Returns the number of whole items read.  Requests at
+   least a buffer long are read directly when the buffer is
+   empty. */
+size_t
+fread (void *buffer, size_t size, size_t cnt, FILE *stream) 
+{
+  char *dst = buffer;
+  size_t total = size * cnt;
+  size_t done = 0;
+
+  if (total == 0 || !start_reading (stream))
+    return 0;
+
+  while (done < total) 
+    {
+      size_t left = total - done;
+
+      if (stream->pos < stream->len) 
+        {
+          size_t chunk = stream->len - stream->pos;
+          if (chunk > left)
+            chunk = left;
+          memcpy (dst + done, stream->buf + stream->pos, chunk);
+          stream->pos += chunk;
+          done += chunk;
+        }
+      else 
+        {
+          bool direct = left >= BUFSIZ;
+          int n = read (stream->fd, direct ? dst + done : stream->buf,
+                        direct ? left : BUFSIZ);
+          if (n <= 0) 
+            {
+              if (n == 0)
+                stream->eof = true;
+              else
+                stream->error = true;
+              break;
+            }
+          if (direct)
+            done += n;
+          else 
+            {
+              stream->pos = 0;
+              stream->len = n;
+            }
+        }
+    }
+  return done / size;
+}
+
+/* Returns true if STREAM has hit end of file. */
+int
+feof (FILE *stream) 
+{
+  return stream->eof;
+}
+
+/* Returns true if a read or write on STREAM has failed. */
+int
+ferror (FILE *stream) 
+{
+  return stream->error;
+}
+
+/* Writes C to STREAM.  Returns C, or EOF on failure. */
+int
+fputc (int c, FILE *stream) 
+{
+  unsigned char c2 = c;
+
+  if (stream->mode == _IONBF)
+    return fwrite (&c2, 1, 1, stream) == 1 ? c2 : EOF;
+
+  start_writing (stream);
+  stream->buf[stream->pos++] = c2;
+  if (stream->pos == BUFSIZ || (stream->mode == _IOLBF && c2 == '\n'))
+    if (fflush (stream) == EOF)
+      return EOF;
+  return c2;
+}
+
+/* Writes string S to STREAM, without a new-line.  Returns 0 if
+   successful, EOF on failure. */
+int
+fputs (const char *s, FILE *stream) 
+{
+  size_t len = strlen (s);
+  return fwrite (s, 1, len, stream) == len ? 0 : EOF;
+}
+
+/* Writes CNT items of SIZE bytes each from BUFFER to STREAM.
+   Returns the number of whole items written. */
+size_t
+fwrite (const void *buffer, size_t size, size_t cnt, FILE *stream) 
+{
+  const char *src = buffer;
+  size_t total = size * cnt;
+  size_t done = 0;
+  bool newline = false;
+
+  if (total == 0)
+    return 0;
+  start_writing (stream);
+
+  if (stream->mode == _IONBF
+      || (stream->pos == 0 && total >= BUFSIZ)) 
+    {
+      /* Nothing is buffered, so write directly. */
+      int n = write (stream->fd, src, total);
+      if (n < 0 || (size_t) n != total) 
+        {
+          stream->error = true;
+          return n < 0 ? 0 : n / size;
+        }
+      return cnt;
+    }
+
+  while (done < total) 
+    {
+      size_t chunk = BUFSIZ - stream->pos;
+      if (chunk > total - done)
+        chunk = total - done;
+      memcpy (stream->buf + stream->pos, src + done, chunk);
+      stream->pos += chunk;
+      done += chunk;
+      if (stream->pos == BUFSIZ && fflush (stream) == EOF)
+        return 0;
+    }
+
+  if (stream->mode == _IOLBF)
+    newline = memchr (src, '\n', total) != NULL;
+  if (newline && fflush (stream) == EOF)
+    return 0;
+  return cnt;
+}
+
+/* Like printf(), but writes to STREAM. */
+int
+fprintf (FILE *stream, const char *format, ...) 
+{
+  va_list args;
+  int retval;
+
+  va_start (args, format);
+  retval = vfprintf (stream, format, args);
+  va_end (args);
+
+  return retval;
+}
+
+/* Auxiliary data for vfprintf_helper(). */
+struct vfprintf_aux 
+  {
+    FILE *stream;       /* Output stream. */
+    int char_cnt;       /* Total characters written so far. */
+    bool newline;       /* Wrote a new-line character. */
+  };
+
+/* Like vprintf(), but writes to STREAM.  The whole message is
+   buffered before a line-buffered or unbuffered stream is
+   flushed, so that it normally reaches the file in one write. */
+int
+vfprintf (FILE *stream, const char *format, va_list args) 
+{
+  struct vfprintf_aux aux;
+  int mode = stream->mode;
+
+  aux.stream = stream;
+  aux.char_cnt = 0;
+  aux.newline = false;
+
+  stream->mode = _IOFBF;
+  __vprintf (format, args, vfprintf_helper, &aux);
+  stream->mode = mode;
+
+  if ((mode == _IONBF || (mode == _IOLBF && aux.newline))
+      && fflush (stream) == EOF)
+    return EOF;
+  return aux.char_cnt;
+}
+
+/* __vprintf() helper that appends C to the stream in AUX. */
+static void
+vfprintf_helper (char c, void *aux_) 
+{
+  struct vfprintf_aux *aux = aux_;
+
+  fputc (c, aux->stream);
+  if (c == '\n')
+    aux->newline = true;
+  aux->char_cnt++;
+}
+
+/* Prepares STREAM for output, dropping any input read ahead. */
+static void
+start_writing (FILE *stream) 
+{
+  if (!stream->writing) 
+    {
+      /* Move the file position back over unread input. */
+      if (stream->len > stream->pos && stream->fd != STDIN_FILENO)
+        seek (stream->fd, tell (stream->fd) - (stream->len - stream->pos));
+      stream->pos = stream->len = 0;
+      stream->writing = true;
+    }
+}
+
+/* Prepares STREAM for input, flushing any pending output, and
+   stdout's too if STREAM reads the console.  Returns true if
+   successful. */
+static bool
+start_reading (FILE *stream) 
+{
+  /* Make prompts visible before waiting for console input. */
+  if (stream->fd == STDIN_FILENO)
+    fflush (stdout);
+
+  if (stream->writing) 
+    {
+      if (fflush (stream) == EOF)
+        return false;
+      stream->pos = stream->len = 0;
+      stream->writing = false;
+    }
+  return true;
+}
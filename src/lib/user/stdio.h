@@ -4,4 +4,41 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffered streams. */
+#define BUFSIZ 512              /* Size of each stream's buffer. */
+#define FOPEN_MAX 8             /* Streams open at once, with stdin/out. */
+#define EOF (-1)                /* End of file or error. */
+
+/* Buffering modes for setvbuf(). */
+#define _IOFBF 0                /* Fully buffered. */
+#define _IOLBF 1                /* Line buffered. */
+#define _IONBF 2                /* Unbuffered. */
+
+typedef struct FILE FILE;
+extern FILE *stdin;
+extern FILE *stdout;
+
+FILE *fopen (const char *name);
+FILE *fdopen (int fd);
+int fclose (FILE *);
+int fflush (FILE *);
+int setvbuf (FILE *, int mode);
+int fileno (FILE *);
+
+int fgetc (FILE *);
+char *fgets (char *, int size, FILE *);
+size_t fread (void *, size_t size, size_t cnt, FILE *);
+int feof (FILE *);
+int ferror (FILE *);
+
+int fputc (int, FILE *);
+int fputs (const char *, FILE *);
+size_t fwrite (const void *, size_t size, size_t cnt, FILE *);
+int fprintf (FILE *, const char *, ...) PRINTF_FORMAT (2, 3);
+int vfprintf (FILE *, const char *, va_list) PRINTF_FORMAT (2, 0);
+
+#define getc(STREAM) fgetc (STREAM)
+#define getchar() fgetc (stdin)
+#define putc(C, STREAM) fputc (C, STREAM)
+
 #endif /* lib/user/stdio.h */
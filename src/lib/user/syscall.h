@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include "../syscall-nr.h"
 
 /* Process identifier. */
 typedef int pid_t;
@@ -23,6 +24,7 @@ typedef int mapid_t;
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t exec (const char *file);
+pid_t fork (void);
 int wait (pid_t);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
@@ -45,4 +47,19 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int stats (int kind, void *buffer, unsigned size);
+struct ring *ring_setup (void *addr);
+int ring_enter (unsigned to_submit);
+int ttymode (int mode);
+bool pipe (int fds[2]);
+int shm_create (void *addr, unsigned size);
+bool shm_attach (int id, void *addr);
+bool shm_detach (void *addr);
+int getdents (int fd, struct dirent *ents, unsigned size);
+
 #endif /* lib/user/syscall.h */
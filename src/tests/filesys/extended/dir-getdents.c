@@ -0,0 +1,65 @@
+/* Creates a directory holding more entries than fit in one
+   getdents() buffer, then checks that successive getdents()
+   calls return every entry exactly once with the right type. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 20
+
+void
+test_main (void) 
+{
+  struct dirent ents[4];
+  bool seen[FILE_CNT + 1];
+  int fd, cnt, total = 0;
+  int i;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (mkdir ("a/d"), "mkdir \"a/d\"");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "a/f%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+  msg ("created %d files", FILE_CNT);
+
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  memset (seen, 0, sizeof seen);
+  while ((cnt = getdents (fd, ents, sizeof ents)) > 0)
+    for (i = 0; i < cnt; i++)
+      {
+        int idx;
+
+        if (!strcmp (ents[i].name, "d"))
+          {
+            if (!ents[i].is_dir)
+              fail ("\"d\" is not a directory");
+            idx = FILE_CNT;
+          }
+        else
+          {
+            idx = atoi (ents[i].name + 1);
+            if (ents[i].name[0] != 'f' || idx < 0 || idx >= FILE_CNT
+                || ents[i].is_dir)
+              fail ("unexpected entry \"%s\"", ents[i].name);
+          }
+        if (seen[idx])
+          fail ("entry \"%s\" returned twice", ents[i].name);
+        seen[idx] = true;
+        total++;
+      }
+  if (cnt < 0)
+    fail ("getdents failed");
+  if (total != FILE_CNT + 1)
+    fail ("read %d entries, expected %d", total, FILE_CNT + 1);
+  msg ("read %d entries", total);
+  CHECK (getdents (fd, ents, sizeof ents) == 0, "getdents at end");
+  close (fd);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-getdents) begin
+(dir-getdents) mkdir "a"
+(dir-getdents) mkdir "a/d"
+(dir-getdents) created 20 files
+(dir-getdents) open "a"
+(dir-getdents) read 21 entries
+(dir-getdents) getdents at end
+(dir-getdents) end
+EOF
+pass;
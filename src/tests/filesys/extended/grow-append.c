@@ -0,0 +1,44 @@
+/* Grows a file by appending to it through a fresh descriptor
+   each time, closing it in between, so that most appends land
+   inside the file's last allocated sector.  Checks that the
+   file's size and contents survive each close. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[322];
+
+/* Bytes appended by each step.  The running sizes, 10, 15, 315
+   and 322, alternately stay within a sector and cross into a
+   new one. */
+static const size_t appends[] = {10, 5, 300, 7};
+
+void
+test_main (void) 
+{
+  const char *file_name = "testme";
+  size_t ofs = 0;
+  size_t i;
+  int fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  for (i = 0; i < sizeof appends / sizeof *appends; i++) 
+    {
+      CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+      if (filesize (fd) != (int) ofs)
+        fail ("\"%s\" is %d bytes long, should be %zu",
+              file_name, filesize (fd), ofs);
+      seek (fd, ofs);
+      msg ("append %zu bytes to \"%s\"", appends[i], file_name);
+      if (write (fd, buf + ofs, appends[i]) != (int) appends[i])
+        fail ("append %zu bytes at offset %zu in \"%s\" failed",
+              appends[i], ofs, file_name);
+      ofs += appends[i];
+      msg ("close \"%s\"", file_name);
+      close (fd);
+    }
+  check_file (file_name, buf, sizeof buf);
+}
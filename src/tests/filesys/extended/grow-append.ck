@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-append) begin
+(grow-append) create "testme"
+(grow-append) open "testme"
+(grow-append) append 10 bytes to "testme"
+(grow-append) close "testme"
+(grow-append) open "testme"
+(grow-append) append 5 bytes to "testme"
+(grow-append) close "testme"
+(grow-append) open "testme"
+(grow-append) append 300 bytes to "testme"
+(grow-append) close "testme"
+(grow-append) open "testme"
+(grow-append) append 7 bytes to "testme"
+(grow-append) close "testme"
+(grow-append) open "testme" for verification
+(grow-append) verified contents of "testme"
+(grow-append) close "testme"
+(grow-append) end
+EOF
+pass;
@@ -0,0 +1,21 @@
+/* Child process run by pipe-child test.
+
+   Writes a message into the pipe write end whose descriptor,
+   inherited from the parent, is passed as the first command-line
+   argument. */
+
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-pipe";
+
+int
+main (int argc UNUSED, char *argv[]) 
+{
+  static const char message[] = "through the pipe";
+
+  if (write (atoi (argv[1]), message, sizeof message) != sizeof message)
+    fail ("write to pipe failed");
+  return 0;
+}
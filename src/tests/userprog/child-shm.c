@@ -0,0 +1,25 @@
+/* Child process run by shm-child test.
+
+   Attaches the shared memory segment whose ID is passed as the
+   first command-line argument, checks the parent's message in
+   its first page and writes a reply into its second page. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+#define SHM_ADDR ((char *) 0x20000000)
+
+const char *test_name = "child-shm";
+
+int
+main (int argc UNUSED, char *argv[]) 
+{
+  if (!shm_attach (atoi (argv[1]), SHM_ADDR))
+    fail ("shm_attach failed");
+  if (strcmp (SHM_ADDR, "from parent"))
+    fail ("read \"%s\" instead of \"from parent\"", SHM_ADDR);
+  strlcpy (SHM_ADDR + 4096, "from child", 4096);
+  return 0;
+}
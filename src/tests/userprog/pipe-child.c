@@ -0,0 +1,30 @@
+/* Creates a pipe, runs a child process that inherits it and
+   writes a message into it, then reads the message back and
+   checks for end of file once every write end is closed. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char expected[] = "through the pipe";
+  char child_cmd[128];
+  char buf[64];
+  int fds[2];
+
+  CHECK (pipe (fds), "pipe");
+  snprintf (child_cmd, sizeof child_cmd, "child-pipe %d", fds[1]);
+  msg ("wait(exec()) = %d", wait (exec (child_cmd)));
+
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == sizeof expected,
+         "read message from child");
+  if (memcmp (buf, expected, sizeof expected))
+    fail ("read \"%s\" instead of \"%s\"", buf, expected);
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read end of file");
+  CHECK (write (fds[0], buf, 1) == -1, "write to read end fails");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-child) begin
+(pipe-child) pipe
+child-pipe: exit(0)
+(pipe-child) wait(exec()) = 0
+(pipe-child) read message from child
+(pipe-child) read end of file
+(pipe-child) write to read end fails
+(pipe-child) end
+pipe-child: exit(0)
+EOF
+pass;
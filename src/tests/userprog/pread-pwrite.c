@@ -0,0 +1,38 @@
+/* Writes and reads back data at explicit offsets with pwrite()
+   and pread(), and checks that the file position is left
+   untouched. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char first[] = "positional";
+  static const char second[] = "io";
+  char buf[sizeof first];
+  int handle;
+
+  CHECK (create ("pio.txt", 0), "create \"pio.txt\"");
+  CHECK ((handle = open ("pio.txt")) > 1, "open \"pio.txt\"");
+
+  CHECK (pwrite (handle, first, sizeof first, 100) == sizeof first,
+         "pwrite \"%s\" at offset 100", first);
+  CHECK (pwrite (handle, second, sizeof second, 10) == sizeof second,
+         "pwrite \"%s\" at offset 10", second);
+  CHECK (tell (handle) == 0, "file position is still 0");
+  CHECK (filesize (handle) == 100 + sizeof first, "file size is %d",
+         (int) (100 + sizeof first));
+
+  CHECK (pread (handle, buf, sizeof first, 100) == sizeof first,
+         "pread at offset 100");
+  compare_bytes (buf, first, sizeof first, 100, "pio.txt");
+  CHECK (pread (handle, buf, sizeof second, 10) == sizeof second,
+         "pread at offset 10");
+  compare_bytes (buf, second, sizeof second, 10, "pio.txt");
+  CHECK (pread (handle, buf, 1, 0) == 1 && buf[0] == 0,
+         "pread of unwritten byte returns zero");
+  CHECK (tell (handle) == 0, "file position is still 0");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) create "pio.txt"
+(pread-pwrite) open "pio.txt"
+(pread-pwrite) pwrite "positional" at offset 100
+(pread-pwrite) pwrite "io" at offset 10
+(pread-pwrite) file position is still 0
+(pread-pwrite) file size is 111
+(pread-pwrite) pread at offset 100
+(pread-pwrite) pread at offset 10
+(pread-pwrite) pread of unwritten byte returns zero
+(pread-pwrite) file position is still 0
+(pread-pwrite) end
+pread-pwrite: exit(0)
+EOF
+pass;
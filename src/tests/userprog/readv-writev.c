@@ -0,0 +1,43 @@
+/* Gathers three buffers into a file with one writev() call,
+   then scatters the file back into differently sized buffers
+   with one readv() call. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char expected[] = "scatter/gather";
+  char a[] = "scat", b[] = "ter/", c[] = "gather";
+  char x[8], y[32];
+  struct iovec out[3], in[2];
+  int handle;
+
+  out[0].iov_base = a;
+  out[0].iov_len = strlen (a);
+  out[1].iov_base = b;
+  out[1].iov_len = strlen (b);
+  out[2].iov_base = c;
+  out[2].iov_len = strlen (c);
+
+  CHECK (create ("sg.txt", 0), "create \"sg.txt\"");
+  CHECK ((handle = open ("sg.txt")) > 1, "open \"sg.txt\"");
+  CHECK (writev (handle, out, 3) == (int) strlen (expected),
+         "writev 3 buffers");
+
+  memset (x, 0, sizeof x);
+  memset (y, 0, sizeof y);
+  in[0].iov_base = x;
+  in[0].iov_len = sizeof x;
+  in[1].iov_base = y;
+  in[1].iov_len = sizeof y;
+  seek (handle, 0);
+  CHECK (readv (handle, in, 2) == (int) strlen (expected),
+         "readv into 2 buffers");
+  compare_bytes (x, expected, sizeof x, 0, "sg.txt");
+  compare_bytes (y, expected + sizeof x, strlen (expected) - sizeof x,
+                 sizeof x, "sg.txt");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "sg.txt"
+(readv-writev) open "sg.txt"
+(readv-writev) writev 3 buffers
+(readv-writev) readv into 2 buffers
+(readv-writev) end
+readv-writev: exit(0)
+EOF
+pass;
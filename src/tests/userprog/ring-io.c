@@ -0,0 +1,54 @@
+/* Queues an open, a write, a positional read and a close on a
+   submission ring and runs them with a single ring_enter(). */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RING_ADDR ((void *) 0x10000000)
+
+static void
+queue (struct ring *ring, int op, int fd, void *buf, unsigned len,
+       int offset) 
+{
+  struct ring_sqe *sqe = &ring->sq[ring->sq_tail % RING_ENTRIES];
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->offset = offset;
+  sqe->user_data = ring->sq_tail;
+  ring->sq_tail++;
+}
+
+void
+test_main (void) 
+{
+  static char data[] = "submitted through the ring";
+  char buf[sizeof data];
+  struct ring *ring;
+  int handle;
+  unsigned i;
+
+  CHECK (create ("ring.txt", 0), "create \"ring.txt\"");
+  CHECK ((handle = open ("ring.txt")) > 1, "open \"ring.txt\"");
+  CHECK ((ring = ring_setup (RING_ADDR)) == RING_ADDR, "ring_setup");
+  CHECK (ring_setup ((void *) 0x20000000) == NULL, "second ring_setup fails");
+
+  queue (ring, RING_NOP, 0, NULL, 0, 0);
+  queue (ring, RING_WRITE, handle, data, sizeof data, -1);
+  queue (ring, RING_READ, handle, buf, sizeof buf, 0);
+  queue (ring, RING_CLOSE, handle, NULL, 0, 0);
+  CHECK (ring_enter (4) == 4, "ring_enter runs 4 operations");
+  CHECK (ring->sq_head == 4 && ring->cq_tail == 4, "ring counters advanced");
+
+  for (i = 0; i < 4; i++)
+    if (ring->cq[i].user_data != i)
+      fail ("completion %u out of order", i);
+  CHECK (ring->cq[1].result == sizeof data, "write completed");
+  CHECK (ring->cq[2].result == sizeof data, "read completed");
+  compare_bytes (buf, data, sizeof data, 0, "ring.txt");
+  CHECK (tell (handle) == 0, "handle closed");
+}
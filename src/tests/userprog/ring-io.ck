@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-io) begin
+(ring-io) create "ring.txt"
+(ring-io) open "ring.txt"
+(ring-io) ring_setup
+(ring-io) second ring_setup fails
+(ring-io) ring_enter runs 4 operations
+(ring-io) ring counters advanced
+(ring-io) write completed
+(ring-io) read completed
+(ring-io) handle closed
+(ring-io) end
+ring-io: exit(0)
+EOF
+pass;
@@ -0,0 +1,30 @@
+/* Creates a shared memory segment, runs a child process that
+   attaches it at a different address, checks the parent's
+   message and writes a reply, then reads the reply back. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SHM_ADDR ((char *) 0x10000000)
+
+void
+test_main (void) 
+{
+  char child_cmd[128];
+  int id;
+
+  CHECK ((id = shm_create (SHM_ADDR, 8192)) >= 0, "shm_create");
+  CHECK (!shm_attach (id, SHM_ADDR + 1), "unaligned shm_attach fails");
+  strlcpy (SHM_ADDR, "from parent", 4096);
+  snprintf (child_cmd, sizeof child_cmd, "child-shm %d", id);
+  msg ("wait(exec()) = %d", wait (exec (child_cmd)));
+
+  if (strcmp (SHM_ADDR + 4096, "from child"))
+    fail ("read \"%s\" instead of \"from child\"", SHM_ADDR + 4096);
+  msg ("read reply from child");
+  CHECK (shm_detach (SHM_ADDR), "shm_detach");
+  CHECK (!shm_detach (SHM_ADDR), "second shm_detach fails");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-child) begin
+(shm-child) shm_create
+(shm-child) unaligned shm_attach fails
+child-shm: exit(0)
+(shm-child) wait(exec()) = 0
+(shm-child) read reply from child
+(shm-child) shm_detach
+(shm-child) second shm_detach fails
+(shm-child) end
+shm-child: exit(0)
+EOF
+pass;
@@ -0,0 +1,25 @@
+/* Checks that the stats system call counts system calls made by
+   this process. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct syscall_stat before[SYS_STATS + 1], after[SYS_STATS + 1];
+  int i;
+
+  CHECK (stats (STATS_SYSCALLS, before, sizeof before) == sizeof before,
+         "stats");
+  for (i = 0; i < 10; i++)
+    tell (1);
+  CHECK (stats (STATS_SYSCALLS, after, sizeof after) == sizeof after,
+         "stats");
+  CHECK (after[SYS_TELL].count - before[SYS_TELL].count == 10,
+         "counted 10 calls to tell");
+  CHECK (after[SYS_STATS].count - before[SYS_STATS].count == 1,
+         "counted 1 call to stats");
+  CHECK (stats (-1, after, sizeof after) == -1, "unknown kind fails");
+}
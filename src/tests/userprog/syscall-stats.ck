@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(syscall-stats) begin
+(syscall-stats) stats
+(syscall-stats) stats
+(syscall-stats) counted 10 calls to tell
+(syscall-stats) counted 1 call to stats
+(syscall-stats) unknown kind fails
+(syscall-stats) end
+syscall-stats: exit(0)
+EOF
+pass;
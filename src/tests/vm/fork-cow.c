@@ -0,0 +1,39 @@
+/* Forks a child that overwrites a 64 kB array it shares
+   copy-on-write with its parent, then verifies that the parent
+   still sees the original contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  msg ("initialize");
+  memset (buf, 0x5a, sizeof buf);
+
+  child = fork ();
+  if (child == 0)
+    {
+      memset (buf, 0xa5, sizeof buf);
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != (char) 0xa5)
+          exit (1);
+      exit (81);
+    }
+  CHECK (child != PID_ERROR, "fork");
+  CHECK (wait (child) == 81, "wait for child");
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0x5a)
+      fail ("byte %zu != 0x5a", i);
+}
@@ -0,0 +1,32 @@
+/* Reads a 1 MB array in BSS, which must be all zeros, then
+   writes every other page of it and verifies that the written
+   pages hold their new contents while the rest stay zero. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+#define PAGE 4096
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu != 0", i);
+
+  msg ("write pass");
+  for (i = 0; i < SIZE; i += 2 * PAGE)
+    memset (buf + i, 0x5a, PAGE);
+
+  msg ("check pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != ((i / PAGE) % 2 == 0 ? 0x5a : 0))
+      fail ("byte %zu has wrong value", i);
+}
@@ -0,0 +1,31 @@
+/* Checks that the stats system call reports the calling
+   process's page faults and resident pages. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGES 16
+#define PAGE 4096
+
+static char buf[PAGES * PAGE];
+
+void
+test_main (void)
+{
+  struct vm_stat before, after;
+
+  CHECK (stats (STATS_VM, &before, sizeof before) == sizeof before,
+         "stats");
+  memset (buf, 0x5a, sizeof buf);
+  CHECK (stats (STATS_VM, &after, sizeof after) == sizeof after,
+         "stats");
+  CHECK (after.minor_faults + after.major_faults
+         >= before.minor_faults + before.major_faults + PAGES,
+         "counted faults on %d pages", PAGES);
+  CHECK (after.resident_pages >= before.resident_pages + PAGES,
+         "counted %d new resident pages", PAGES);
+  CHECK (after.peak_resident_pages >= after.resident_pages,
+         "peak is at least current");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(vm-stats) begin
+(vm-stats) stats
+(vm-stats) stats
+(vm-stats) counted faults on 16 pages
+(vm-stats) counted 16 new resident pages
+(vm-stats) peak is at least current
+(vm-stats) end
+vm-stats: exit(0)
+EOF
+pass;
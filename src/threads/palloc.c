@@ -10,6 +10,7 @@
 #include "threads/init.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,7 +25,19 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool also keeps up to ZEROED_MAX pages that have already
+   been zeroed, so that a single-page PAL_ZERO request does not
+   have to clear its page on the caller's time.  A PRI_MIN
+   thread, which runs only when nothing else is ready, refills
+   them.  Only kernels that run user programs, which ask for
+   zeroed pages on every exec and page fault, start it, and not
+   under the MLFQS scheduler, which would raise its priority
+   and count it toward the load average.  The pre-zeroed pages are marked used in the bitmap and
+   linked through their first word, which is cleared again when
+   a page is handed out.  A request the bitmap cannot satisfy
+   takes the pre-zeroed pages back first. */
 
 /* A memory pool. */
 struct pool
@@ -32,17 +45,29 @@ struct pool
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    void *zeroed;                       /* List of pre-zeroed pages. */
+    size_t zeroed_cnt;                  /* Number of pages in ZEROED. */
   };
 
+/* Most pre-zeroed pages kept in each pool. */
+#define ZEROED_MAX 32
+
 /* Two pools: one for kernel data, one for user pages. */
 struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
 
+/* Upped whenever a pre-zeroed page is used, to wake the zeroing
+   thread. */
+static struct semaphore zero_sema;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void release_zeroed (struct pool *);
+static void refill_zeroed (struct pool *);
+static thread_func zero_thread NO_RETURN;
 
 /* Initializes the page allocator. */
 void
@@ -66,6 +91,18 @@ palloc_init (void)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+  sema_init (&zero_sema, 0);
+}
+
+/* Starts the thread that keeps the pools' pre-zeroed pages
+   filled, unless the MLFQS scheduler is in use.  Must be called
+   after the scheduler has started. */
+void
+palloc_start (void) 
+{
+  if (thread_mlfqs)
+    return;
+  thread_create ("zero", PRI_MIN, zero_thread, NULL);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -78,24 +115,42 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
+  void *pages = NULL;
+  bool zeroed = false;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+  if (page_cnt == 1 && (flags & PAL_ZERO) && pool->zeroed != NULL)
+    {
+      /* Take a pre-zeroed page and clear its link. */
+      pages = pool->zeroed;
+      pool->zeroed = *(void **) pages;
+      pool->zeroed_cnt--;
+      *(void **) pages = NULL;
+      zeroed = true;
+    }
   else
-    pages = NULL;
+    {
+      page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+      if (page_idx == BITMAP_ERROR && pool->zeroed != NULL)
+        {
+          release_zeroed (pool);
+          page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt,
+                                           false);
+        }
+      if (page_idx != BITMAP_ERROR)
+        pages = pool->base + PGSIZE * page_idx;
+    }
+  lock_release (&pool->lock);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if (zeroed)
+        sema_up (&zero_sema);
+      else if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -174,6 +229,68 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   lock_init (&p->lock);
   p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
   p->base = base + bm_pages * PGSIZE;
+  p->zeroed = NULL;
+  p->zeroed_cnt = 0;
+}
+
+/* Returns all of POOL's pre-zeroed pages to its bitmap.
+   POOL's lock must be held. */
+static void
+release_zeroed (struct pool *pool) 
+{
+  ASSERT (lock_held_by_current_thread (&pool->lock));
+
+  while (pool->zeroed != NULL)
+    {
+      void *page = pool->zeroed;
+      pool->zeroed = *(void **) page;
+      bitmap_reset (pool->used_map, pg_no (page) - pg_no (pool->base));
+    }
+  pool->zeroed_cnt = 0;
+}
+
+/* Zeroes free pages of POOL and adds them to its pre-zeroed
+   pages until it has ZEROED_MAX of them or runs out. */
+static void
+refill_zeroed (struct pool *pool) 
+{
+  for (;;)
+    {
+      size_t page_idx;
+      void *page;
+
+      lock_acquire (&pool->lock);
+      page_idx = (pool->zeroed_cnt < ZEROED_MAX
+                  ? bitmap_scan_and_flip (pool->used_map, 0, 1, false)
+                  : BITMAP_ERROR);
+      lock_release (&pool->lock);
+      if (page_idx == BITMAP_ERROR)
+        break;
+
+      /* Zero the page without holding the lock. */
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+
+      lock_acquire (&pool->lock);
+      *(void **) page = pool->zeroed;
+      pool->zeroed = page;
+      pool->zeroed_cnt++;
+      lock_release (&pool->lock);
+    }
+}
+
+/* Thread function that refills both pools' pre-zeroed pages
+   each time some are used.  Runs at PRI_MIN, so it only gets the
+   CPU when it would otherwise be idle. */
+static void
+zero_thread (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      refill_zeroed (&kernel_pool);
+      refill_zeroed (&user_pool);
+      sema_down (&zero_sema);
+    }
 }
 
 /* Returns true if PAGE was allocated from POOL,
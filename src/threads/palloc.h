@@ -15,6 +15,7 @@ enum palloc_flags
 extern size_t user_page_limit;
 
 void palloc_init (void);
+void palloc_start (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
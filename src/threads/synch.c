@@ -426,6 +426,11 @@ cond_priority_greater (const struct list_elem *a_, const struct list_elem *b_,
 
   //ASSERT(!list_empty(a_list) || !list_empty(b_list));
 
+  /* A waiter that has not reached sema_down() yet has no thread
+     on its semaphore; treat it as lowest priority. */
+  if (list_empty (&a_list) || list_empty (&b_list))
+    return !list_empty (&a_list);
+
   struct thread *a_thread = list_entry(list_front(&a_list), struct thread, elem);
   struct thread *b_thread = list_entry(list_front(&b_list), struct thread, elem);
 
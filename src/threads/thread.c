@@ -497,8 +497,14 @@ init_thread (struct thread *t, const char *name, int priority)
   list_init (&t->child);
 
 #ifdef USERPROG
-  t->fd = 1; // start from 2 (0, 1: STDIN, STDOUT)
-  list_init (&t->fd_list);
+  t->fd_table = NULL;
+  t->fd_cap = 0;
+  t->fd_free = 2; // start from 2 (0, 1: STDIN, STDOUT)
+  t->ring = NULL;
+  list_init (&t->shm_list);
+#ifdef VM
+  list_init (&t->mappings);
+#endif
   list_init (&t->child);
 #endif
 
@@ -4,6 +4,9 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#ifdef VM
+#include <syscall-nr.h>
+#endif
 #include "filesys/directory.h"
 
 /* States in a thread's life cycle. */
@@ -106,12 +109,24 @@ struct thread
     struct semaphore* process_sema;  /* Lock for implement process wait */
     bool *process_load;
 
-    int fd;
-    struct list fd_list;
+    struct fd_entry *fd_table;          /* Open files, indexed by fd. */
+    int fd_cap;                         /* Number of slots in fd_table. */
+    int fd_free;                        /* No free slot below this fd. */
+    struct ring *ring;                  /* Submission ring, or NULL. */
+    struct list shm_list;               /* Attached shared memory. */
     struct file* executable;
+#ifdef VM
+    struct hash *pages;                 /* Supplemental page table. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+    struct intr_frame *syscall_frame;   /* Frame of syscall in progress. */
+    struct vm_stat vm_stat;             /* Paging statistics. */
+#endif
 #endif
 
     struct dir *cwd;
+    int journal_depth;                  /* Nesting of journal operations. */
+    size_t journal_reserved;            /* Sectors its outermost one reserved. */
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
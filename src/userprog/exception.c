@@ -4,12 +4,19 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+#ifdef VM
+static void *user_stack_pointer (struct intr_frame *, bool user);
+#endif
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -147,6 +154,18 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* Bring in a page that has not been read yet, grow the stack,
+     or copy a copy-on-write page being written, whether the
+     process touched the page or the kernel did on its behalf. */
+  if (is_user_vaddr (fault_addr)
+      && (not_present
+          ? (page_in (fault_addr, write)
+             || page_grow_stack (fault_addr, user_stack_pointer (f, user)))
+          : write && page_copy_on_write (fault_addr)))
+    return;
+#endif
+
   if( !user ){
     f->eip =(void (*)(void)) f->eax;
     f->eax = 0xffffffff;
@@ -168,3 +187,19 @@ page_fault (struct intr_frame *f)
   kill (f);
 }
 
+#ifdef VM
+/* Returns the user stack pointer at the time of page fault F,
+   taken in user mode if USER is true.  For a fault the kernel
+   took on the process's behalf, F's %esp is on the kernel stack,
+   so this returns the one saved on system call entry, or a null
+   pointer outside a system call. */
+static void *
+user_stack_pointer (struct intr_frame *f, bool user) 
+{
+  struct intr_frame *sf = thread_current ()->syscall_frame;
+
+  if (user)
+    return f->esp;
+  return sf != NULL ? sf->esp : NULL;
+}
+#endif
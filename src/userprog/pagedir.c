@@ -23,7 +23,8 @@ pagedir_create (void)
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references, except shared pages mapped with
+   pagedir_set_shared_page(). */
 void
 pagedir_destroy (uint32_t *pd) 
 {
@@ -40,7 +41,7 @@ pagedir_destroy (uint32_t *pd)
         uint32_t *pte;
         
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
+          if ((*pte & (PTE_P | PTE_SHARED)) == PTE_P) 
             palloc_free_page (pte_get_page (*pte));
         palloc_free_page (pt);
       }
@@ -118,6 +119,22 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     return false;
 }
 
+/* Like pagedir_set_page(), but marks the mapping as shared:
+   KPAGE belongs to someone else, who keeps track of its users,
+   so pagedir_destroy() leaves it alone. */
+bool
+pagedir_set_shared_page (uint32_t *pd, void *upage, void *kpage,
+                         bool writable)
+{
+  uint32_t *pte;
+
+  if (!pagedir_set_page (pd, upage, kpage, writable))
+    return false;
+  pte = lookup_page (pd, upage, false);
+  *pte |= PTE_SHARED;
+  return true;
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -185,6 +202,22 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
     }
 }
 
+/* Sets the writable bit in the PTE for virtual page VPAGE in PD
+   to WRITABLE.  Used to make pages copy-on-write. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd);
+    }
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD has been
    accessed recently, that is, between the time the PTE was
    installed and the last time it was cleared.  Returns false if
@@ -0,0 +1,163 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A pipe: a one-page ring buffer in kernel memory with a read
+   end and a write end, each of which may be held open by any
+   number of file descriptors.  Readers sleep while it is empty
+   and writers while it is full.  It is freed when both ends are
+   closed. */
+struct pipe
+  {
+    struct lock lock;                   /* Protects everything below. */
+    struct condition not_empty;         /* Signaled when data arrives. */
+    struct condition not_full;          /* Signaled when room appears. */
+    uint8_t *buf;                       /* PIPE_SIZE bytes of data. */
+    unsigned head;                      /* Bytes ever written. */
+    unsigned tail;                      /* Bytes ever read. */
+    int readers;                        /* Open read ends. */
+    int writers;                        /* Open write ends. */
+  };
+
+/* Pipe capacity in bytes.  Must be a power of 2. */
+#define PIPE_SIZE PGSIZE
+
+/* Creates and returns a new pipe with no ends open, or a null
+   pointer if memory is short. */
+struct pipe *
+pipe_create (void) 
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->buf = palloc_get_page (0);
+  if (p->buf == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  lock_init (&p->lock);
+  cond_init (&p->not_empty);
+  cond_init (&p->not_full);
+  p->head = p->tail = 0;
+  p->readers = p->writers = 0;
+  return p;
+}
+
+/* Opens another read end of P, or write end if WRITER. */
+void
+pipe_open (struct pipe *p, bool writer) 
+{
+  lock_acquire (&p->lock);
+  if (writer)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->lock);
+}
+
+/* Closes a read end of P, or write end if WRITER, and frees P
+   if no ends remain open.  Closing the last write end makes
+   readers see end of file; closing the last read end makes
+   writers fail. */
+void
+pipe_close (struct pipe *p, bool writer) 
+{
+  bool done;
+
+  lock_acquire (&p->lock);
+  if (writer)
+    {
+      ASSERT (p->writers > 0);
+      if (--p->writers == 0)
+        cond_broadcast (&p->not_empty, &p->lock);
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      if (--p->readers == 0)
+        cond_broadcast (&p->not_full, &p->lock);
+    }
+  done = p->readers == 0 && p->writers == 0;
+  lock_release (&p->lock);
+
+  if (done)
+    {
+      palloc_free_page (p->buf);
+      free (p);
+    }
+}
+
+/* Reads up to SIZE bytes from P into BUFFER, waiting until at
+   least one byte is available.  Returns the number of bytes
+   read, or 0 at end of file, when P is empty and has no writers
+   left. */
+int
+pipe_read (struct pipe *p, void *buffer_, size_t size) 
+{
+  uint8_t *buffer = buffer_;
+  size_t n = 0;
+
+  lock_acquire (&p->lock);
+  while (p->head == p->tail && p->writers > 0)
+    cond_wait (&p->not_empty, &p->lock);
+
+  while (n < size && p->tail != p->head)
+    {
+      size_t ofs = p->tail % PIPE_SIZE;
+      size_t chunk = PIPE_SIZE - ofs;
+      if (chunk > p->head - p->tail)
+        chunk = p->head - p->tail;
+      if (chunk > size - n)
+        chunk = size - n;
+      memcpy (buffer + n, p->buf + ofs, chunk);
+      p->tail += chunk;
+      n += chunk;
+    }
+  if (n > 0)
+    cond_broadcast (&p->not_full, &p->lock);
+  lock_release (&p->lock);
+
+  return n;
+}
+
+/* Writes all SIZE bytes from BUFFER to P, waiting for room as
+   needed.  Returns the number of bytes written, which is less
+   than SIZE only if every read end is closed partway through,
+   or -1 if no read end was open to begin with. */
+int
+pipe_write (struct pipe *p, const void *buffer_, size_t size) 
+{
+  const uint8_t *buffer = buffer_;
+  size_t n = 0;
+
+  lock_acquire (&p->lock);
+  while (n < size && p->readers > 0)
+    {
+      size_t ofs = p->head % PIPE_SIZE;
+      size_t room = PIPE_SIZE - (p->head - p->tail);
+      size_t chunk = PIPE_SIZE - ofs;
+
+      if (room == 0)
+        {
+          cond_wait (&p->not_full, &p->lock);
+          continue;
+        }
+      if (chunk > room)
+        chunk = room;
+      if (chunk > size - n)
+        chunk = size - n;
+      memcpy (p->buf + ofs, buffer + n, chunk);
+      p->head += chunk;
+      n += chunk;
+      cond_broadcast (&p->not_empty, &p->lock);
+    }
+  lock_release (&p->lock);
+
+  return n == 0 && size > 0 ? -1 : (int) n;
+}
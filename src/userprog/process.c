@@ -7,18 +7,29 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/shm.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 static thread_func start_process NO_RETURN;
+#ifdef VM
+static thread_func fork_process NO_RETURN;
+#endif
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
 struct semaphore *sema_addr;
@@ -111,6 +122,7 @@ start_process (void *f_name)
     sema_up(thread_current()->process_sema);
     thread_exit ();
   }
+  fd_inherit_pipes (thread_current ()->parent);
   /* ----------------------------------------------------------------- */
   /* Haney: From here, the value of arguments will be copied on stack      */
   if_.esp -= sizeof(char) * size;
@@ -154,6 +166,110 @@ start_process (void *f_name)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Handed from process_fork() to fork_process(). */
+struct fork_aux
+  {
+    struct thread *parent;              /* Process calling fork(). */
+    struct intr_frame if_;              /* Its system call frame. */
+    struct semaphore *sema;             /* Signals the parent. */
+    bool *load;                         /* Set to whether the copy worked. */
+  };
+
+/* Starts a new thread running a copy of the current process,
+   which made the system call whose frame is F.  The copy shares
+   the parent's memory copy-on-write and resumes from the same
+   system call, returning 0.  Returns the new process's thread
+   id, or TID_ERROR if it cannot be created. */
+tid_t
+process_fork (struct intr_frame *f) 
+{
+  struct thread *curr = thread_current ();
+  struct child *child_info;
+  struct fork_aux *aux;
+  tid_t tid;
+
+  child_info = palloc_get_page (0);
+  if (child_info == NULL)
+    return TID_ERROR;
+  aux = malloc (sizeof *aux);
+  if (aux == NULL)
+    {
+      palloc_free_page (child_info);
+      return TID_ERROR;
+    }
+  aux->parent = curr;
+  aux->if_ = *f;
+  aux->sema = &child_info->sema;
+  aux->load = &child_info->load;
+
+  sema_init (&child_info->sema, 0);
+  tid = thread_create (curr->name, PRI_DEFAULT, fork_process, aux);
+  if (tid == TID_ERROR)
+    {
+      palloc_free_page (child_info);
+      free (aux);
+      return TID_ERROR;
+    }
+  child_info->tid = tid;
+  list_push_back (&curr->child, &child_info->elem);
+
+  /* The child copies our address space and descriptors while we
+     wait here, so they cannot change underneath it. */
+  sema_down (&child_info->sema);
+  if (!child_info->load)
+    tid = TID_ERROR;
+  sema_up (&child_info->sema);
+  thread_yield ();
+  return tid;
+}
+
+/* A thread function that copies the process that called fork()
+   and makes the copy return to user mode. */
+static void
+fork_process (void *aux_) 
+{
+  struct fork_aux *aux = aux_;
+  struct thread *t = thread_current ();
+  struct thread *parent = aux->parent;
+  struct intr_frame if_ = aux->if_;
+  bool success = false;
+
+  t->process_sema = aux->sema;
+  t->process_load = aux->load;
+  free (aux);
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir != NULL && page_table_create ())
+    {
+      process_activate ();
+      if (parent->cwd != NULL)
+        t->cwd = dir_reopen (parent->cwd);
+      t->executable = file_reopen (parent->executable);
+      if (t->executable != NULL)
+        {
+          file_deny_write (t->executable);
+          success = (page_table_copy (parent, t->executable)
+                     && shm_fork (parent)
+                     && fd_fork (parent));
+        }
+    }
+  *t->process_load = success;
+  if (!success)
+    {
+      sema_up (t->process_sema);
+      thread_exit ();
+    }
+
+  /* fork() returns 0 in the child. */
+  if_.eax = 0;
+  sema_up (t->process_sema);
+  thread_yield ();
+  sema_down (t->process_sema);
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
 
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
@@ -205,6 +321,16 @@ process_exit (void)
 
   if(curr->cwd) dir_close (curr->cwd);
 
+#ifdef VM
+  if (page_print_stats && curr->pages != NULL)
+    page_report_stats ();
+
+  /* Write back mapped files, then free resident pages before
+     their executable is closed. */
+  mmap_exit ();
+  page_table_destroy ();
+#endif
+
   struct file *file = curr->executable;
   if (file != NULL)
   {
@@ -212,6 +338,10 @@ process_exit (void)
     file_close (file);
   }
   
+  /* Drop our references to shared memory, which
+     pagedir_destroy() will not free. */
+  shm_exit ();
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = curr->pagedir;
@@ -309,6 +439,54 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
+/* A loadable segment of an executable, as load_segment()
+   takes it. */
+struct image_segment
+  {
+    off_t file_page;            /* Offset of first page in file. */
+    uint8_t *upage;             /* User address of first page. */
+    uint32_t read_bytes;        /* Bytes to read from the file. */
+    uint32_t zero_bytes;        /* Bytes to zero after those. */
+    bool writable;              /* Writable by the process? */
+  };
+
+/* Everything load() needs from an executable's headers. */
+struct image
+  {
+    struct inode *inode;        /* Executable. */
+    unsigned version;           /* INODE's version when parsed. */
+    void (*entry) (void);       /* Entry point. */
+    size_t seg_cnt;             /* Number of loadable segments. */
+    struct image_segment segs[]; /* Loadable segments. */
+  };
+
+/* Most loadable segments in an executable: as many as fit in a
+   page along with the rest of struct image. */
+#define IMAGE_SEG_MAX ((PGSIZE - sizeof (struct image)) \
+                       / sizeof (struct image_segment))
+
+/* Image cache.
+
+   Every exec() of the same program used to read and check its
+   ELF header and program headers again.  The images of the most
+   recently loaded programs are kept here instead, keyed by
+   inode.  Each holds its inode open, so that the inode's version
+   keeps counting writes; an image whose inode has been written
+   since it was parsed is dropped on the next lookup.  Removing
+   the inode drops its image at once, so that the cache does not
+   keep a deleted file's sectors allocated.  Slots are reused
+   round-robin. */
+#define IMAGE_CACHE_SIZE 8
+
+static struct image *image_cache[IMAGE_CACHE_SIZE];
+static size_t image_hand;               /* Next slot to reuse. */
+static struct lock image_lock;          /* Protects the above. */
+
+static bool read_image (const char *file_name, struct file *,
+                        struct image *);
+static bool image_lookup (struct inode *, struct image *);
+static void image_store (const struct image *);
+static void image_drop (size_t slot);
 static bool setup_stack (void **esp);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
@@ -323,17 +501,20 @@ bool
 load (const char *file_name, void (**eip) (void), void **esp) 
 {
   struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
+  struct image *image = NULL;
   struct file *file = NULL;
-  off_t file_ofs;
   bool success = false;
-  int i;
+  size_t i;
 
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  if (!page_table_create ())
+    goto done;
+#endif
 
   /* Open executable file. */
   file = filesys_open (file_name);
@@ -343,6 +524,93 @@ load (const char *file_name, void (**eip) (void), void **esp)
       goto done; 
     }
 
+  /* Parse its headers, unless we already have. */
+  image = palloc_get_page (0);
+  if (image == NULL)
+    goto done;
+  if (!image_lookup (file_get_inode (file), image))
+    {
+      if (!read_image (file_name, file, image))
+        goto done;
+      image_store (image);
+    }
+
+  /* Load segments. */
+  for (i = 0; i < image->seg_cnt; i++)
+    {
+      struct image_segment *seg = &image->segs[i];
+      if (!load_segment (file, seg->file_page, seg->upage,
+                         seg->read_bytes, seg->zero_bytes, seg->writable))
+        goto done;
+    }
+
+  t->cwd = dir_open_root();
+
+  /* Set up stack. */
+  if (!setup_stack (esp))
+    goto done;
+
+  /* Start address. */
+  *eip = image->entry;
+
+  success = true;
+
+  file_deny_write (file); //todo: terminate 되면 file close 하기, executable file store
+  t->executable = file;
+
+ done:
+  /* We arrive here whether the load is successful or not. */
+  if (!success)
+    file_close (file);
+  palloc_free_page (image);
+  return success;
+}
+
+/* Initializes the image cache. */
+void
+process_init (void) 
+{
+  lock_init (&image_lock);
+}
+
+/* Empties the image cache, closing the inodes it holds open.
+   Called when the file system shuts down. */
+void
+process_done (void) 
+{
+  size_t i;
+
+  lock_acquire (&image_lock);
+  for (i = 0; i < IMAGE_CACHE_SIZE; i++)
+    image_drop (i);
+  lock_release (&image_lock);
+}
+
+/* Drops INODE's image from the image cache, if it is there.
+   Called when INODE is removed. */
+void
+process_forget_image (struct inode *inode) 
+{
+  size_t i;
+
+  lock_acquire (&image_lock);
+  for (i = 0; i < IMAGE_CACHE_SIZE; i++)
+    if (image_cache[i] != NULL && image_cache[i]->inode == inode)
+      image_drop (i);
+  lock_release (&image_lock);
+}
+
+/* Reads and verifies the ELF header and program headers of FILE,
+   opened from FILE_NAME, into IMAGE, which must have room for
+   IMAGE_SEG_MAX segments.  Returns true if successful, false if
+   FILE is not a loadable executable. */
+static bool
+read_image (const char *file_name, struct file *file, struct image *image) 
+{
+  struct Elf32_Ehdr ehdr;
+  off_t file_ofs;
+  int i;
+
   /* Read and verify executable header. */
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
@@ -353,8 +621,12 @@ load (const char *file_name, void (**eip) (void), void **esp)
       || ehdr.e_phnum > 1024) 
     {
       printf ("load: %s: error loading executable\n", file_name);
-      goto done; 
+      return false;
     }
+  image->inode = file_get_inode (file);
+  image->version = inode_version (image->inode);
+  image->entry = (void (*) (void)) ehdr.e_entry;
+  image->seg_cnt = 0;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
@@ -363,11 +635,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
       struct Elf32_Phdr phdr;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        return false;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        return false;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
         {
@@ -381,64 +653,113 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          return false;
         case PT_LOAD:
-          if (validate_segment (&phdr, file)) 
+          if (validate_segment (&phdr, file)
+              && image->seg_cnt < IMAGE_SEG_MAX) 
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+              struct image_segment *seg = &image->segs[image->seg_cnt++];
               uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
+
+              seg->writable = (phdr.p_flags & PF_W) != 0;
+              seg->file_page = phdr.p_offset & ~PGMASK;
+              seg->upage = (uint8_t *) (phdr.p_vaddr & ~PGMASK);
               if (phdr.p_filesz > 0)
                 {
                   /* Normal segment.
                      Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
+                  seg->read_bytes = page_offset + phdr.p_filesz;
+                  seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz,
+                                               PGSIZE)
+                                     - seg->read_bytes);
                 }
               else 
                 {
                   /* Entirely zero.
                      Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+                  seg->read_bytes = 0;
+                  seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz,
+                                              PGSIZE);
                 }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
             }
           else
-            goto done;
+            return false;
           break;
         }
     }
+  return true;
+}
 
-  t->cwd = dir_open_root();
-
-  /* Set up stack. */
-  if (!setup_stack (esp))
-    goto done;
-
-  /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+/* Copies the cached image of INODE into IMAGE, which must have
+   room for IMAGE_SEG_MAX segments.  Returns true if successful,
+   false if INODE's image is not cached or is out of date. */
+static bool
+image_lookup (struct inode *inode, struct image *image) 
+{
+  bool found = false;
+  size_t i;
 
-  success = true;
+  lock_acquire (&image_lock);
+  for (i = 0; i < IMAGE_CACHE_SIZE; i++) 
+    {
+      struct image *c = image_cache[i];
 
-  file_deny_write (file); //todo: terminate 되면 file close 하기, executable file store
-  t->executable = file;
+      if (c == NULL)
+        continue;
+      if (inode_version (c->inode) != c->version)
+        image_drop (i);
+      else if (c->inode == inode)
+        {
+          memcpy (image, c, sizeof *c + c->seg_cnt * sizeof *c->segs);
+          found = true;
+        }
+    }
+  lock_release (&image_lock);
+  return found;
+}
 
- done:
-  /* We arrive here whether the load is successful or not. */
-  if (!success)
-    file_close (file);
-  return success;
+/* Adds a copy of IMAGE to the image cache, replacing the oldest
+   entry if the cache is full.  Does nothing if memory is
+   short. */
+static void
+image_store (const struct image *image) 
+{
+  size_t size = sizeof *image + image->seg_cnt * sizeof *image->segs;
+  struct image *c = malloc (size);
+
+  if (c == NULL)
+    return;
+  memcpy (c, image, size);
+  inode_reopen (c->inode);
+
+  lock_acquire (&image_lock);
+  image_drop (image_hand);
+  image_cache[image_hand] = c;
+  image_hand = (image_hand + 1) % IMAGE_CACHE_SIZE;
+  lock_release (&image_lock);
 }
 
+/* Frees the image in image cache slot SLOT, if any, and closes
+   its inode.  The caller must hold image_lock. */
+static void
+image_drop (size_t slot) 
+{
+  struct image *c = image_cache[slot];
+
+  ASSERT (lock_held_by_current_thread (&image_lock));
+  if (c != NULL)
+    {
+      inode_close (c->inode);
+      free (c);
+      image_cache[slot] = NULL;
+    }
+}
+
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -493,6 +814,8 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
         - ZERO_BYTES bytes at UPAGE + READ_BYTES must be zeroed.
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
+   With VM, the pages are only recorded in the supplemental page
+   table here and read in when first touched.
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -503,7 +826,9 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifndef VM
   file_seek (file, ofs);
+#endif
   while (read_bytes > 0 || zero_bytes > 0) 
     {
       /* Do calculate how to fill this page.
@@ -512,6 +837,19 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+#ifdef VM
+      /* Record where the page comes from. */
+      struct page *p = page_alloc (upage, writable);
+      if (p == NULL)
+        return false;
+      if (page_read_bytes > 0)
+        {
+          p->file = file;
+          p->file_ofs = ofs;
+          p->file_bytes = page_read_bytes;
+        }
+      ofs += page_read_bytes;
+#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -531,6 +869,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
+#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -545,6 +884,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+
+  if (page_alloc (upage, true) == NULL || !page_in (upage, true))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -558,8 +905,10 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -579,3 +928,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
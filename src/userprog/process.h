@@ -12,7 +12,16 @@ struct child{
   struct list_elem elem;
 };
 
+struct inode;
+
+void process_init (void);
+void process_done (void);
+void process_forget_image (struct inode *);
 tid_t process_execute (const char *file_name);
+#ifdef VM
+struct intr_frame;
+tid_t process_fork (struct intr_frame *);
+#endif
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
@@ -0,0 +1,302 @@
+#include "userprog/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Shared memory segments.
+
+   A segment is a set of user pool frames that may be mapped
+   into several processes' page directories at once.  The
+   mappings are marked shared, so pagedir_destroy() does not free
+   the frames; instead each segment counts its attachments and
+   frees its frames when the last one goes away, whether by
+   shm_detach() or by process exit.
+
+   The frames come straight from the user pool, not from the VM
+   frame table, so they are never evicted and the frame table
+   has that many fewer frames to page with.  To bound that, all
+   segments together hold at most SHM_TOTAL_PAGES pages. */
+
+/* A shared memory segment. */
+struct shm_segment
+  {
+    struct list_elem elem;      /* Element in segments. */
+    int id;                     /* Segment identifier. */
+    int attach_cnt;             /* Number of attachments. */
+    size_t page_cnt;            /* Number of pages. */
+    void **frames;              /* Kernel addresses of the frames. */
+  };
+
+/* One process's attachment of a segment. */
+struct shm_attachment
+  {
+    struct list_elem elem;      /* Element in thread's shm_list. */
+    struct shm_segment *seg;    /* Attached segment. */
+    void *addr;                 /* User address of first page. */
+  };
+
+static struct list segments;    /* All segments. */
+static struct lock shm_lock;    /* Protects segments and attach_cnt. */
+static int next_id;             /* Next segment identifier. */
+static size_t total_pages;      /* Pages in all segments. */
+
+static struct shm_segment *find_segment (int id);
+static bool map_segment (struct shm_segment *, void *addr);
+static void detach (struct shm_attachment *);
+
+/* Initializes the shared memory module. */
+void
+shm_init (void) 
+{
+  list_init (&segments);
+  lock_init (&shm_lock);
+  next_id = 1;
+  total_pages = 0;
+}
+
+/* Creates a zeroed segment of SIZE bytes, rounded up to whole
+   pages, and attaches it to the current process at ADDR.
+   Returns the segment's identifier, or -1 on failure. */
+int
+shm_create (void *addr, size_t size) 
+{
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  struct shm_segment *seg;
+  size_t i;
+  int id;
+
+  if (size == 0 || page_cnt > SHM_MAX_PAGES)
+    return -1;
+
+  lock_acquire (&shm_lock);
+  if (total_pages + page_cnt > SHM_TOTAL_PAGES)
+    {
+      lock_release (&shm_lock);
+      return -1;
+    }
+  total_pages += page_cnt;
+  lock_release (&shm_lock);
+
+  seg = malloc (sizeof *seg);
+  if (seg == NULL)
+    goto fail_count;
+  seg->frames = calloc (page_cnt, sizeof *seg->frames);
+  if (seg->frames == NULL)
+    {
+      free (seg);
+      goto fail_count;
+    }
+  seg->page_cnt = page_cnt;
+  seg->attach_cnt = 0;
+  for (i = 0; i < page_cnt; i++)
+    {
+      seg->frames[i] = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (seg->frames[i] == NULL)
+        goto fail;
+    }
+
+  lock_acquire (&shm_lock);
+  if (!map_segment (seg, addr))
+    {
+      lock_release (&shm_lock);
+      goto fail;
+    }
+  seg->id = id = next_id++;
+  list_push_back (&segments, &seg->elem);
+  lock_release (&shm_lock);
+  return id;
+
+ fail:
+  for (i = 0; i < page_cnt; i++)
+    palloc_free_page (seg->frames[i]);
+  free (seg->frames);
+  free (seg);
+ fail_count:
+  lock_acquire (&shm_lock);
+  total_pages -= page_cnt;
+  lock_release (&shm_lock);
+  return -1;
+}
+
+/* Attaches segment ID to the current process at ADDR.  Returns
+   true if successful, false if there is no such segment or the
+   pages at ADDR are not free. */
+bool
+shm_attach (int id, void *addr) 
+{
+  struct shm_segment *seg;
+  bool success = false;
+
+  lock_acquire (&shm_lock);
+  seg = find_segment (id);
+  if (seg != NULL)
+    success = map_segment (seg, addr);
+  lock_release (&shm_lock);
+
+  return success;
+}
+
+/* Detaches the segment attached to the current process at ADDR.
+   Returns true if successful, false if none is attached there. */
+bool
+shm_detach (void *addr) 
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->shm_list); e != list_end (&t->shm_list);
+       e = list_next (e))
+    {
+      struct shm_attachment *a = list_entry (e, struct shm_attachment, elem);
+      if (a->addr == addr)
+        {
+          detach (a);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Detaches every segment attached to the current process.
+   Called when the process exits. */
+void
+shm_exit (void) 
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->shm_list))
+    detach (list_entry (list_front (&t->shm_list),
+                        struct shm_attachment, elem));
+}
+
+/* Attaches every segment that PARENT, which has just created the
+   current process with fork(), has attached, at the same
+   address.  Returns true if successful, false if memory is
+   short. */
+bool
+shm_fork (struct thread *parent) 
+{
+  struct list_elem *e;
+  bool success = true;
+
+  lock_acquire (&shm_lock);
+  for (e = list_begin (&parent->shm_list); e != list_end (&parent->shm_list);
+       e = list_next (e))
+    {
+      struct shm_attachment *a = list_entry (e, struct shm_attachment, elem);
+      if (!map_segment (a->seg, a->addr))
+        {
+          success = false;
+          break;
+        }
+    }
+  lock_release (&shm_lock);
+  return success;
+}
+
+/* Returns the segment with identifier ID, or a null pointer if
+   there is none.  shm_lock must be held. */
+static struct shm_segment *
+find_segment (int id) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&segments); e != list_end (&segments);
+       e = list_next (e))
+    {
+      struct shm_segment *seg = list_entry (e, struct shm_segment, elem);
+      if (seg->id == id)
+        return seg;
+    }
+  return NULL;
+}
+
+/* Maps SEG into the current process at page-aligned user
+   address ADDR and records the attachment.  Returns true if
+   successful, false if ADDR is unsuitable or memory is short.
+   shm_lock must be held. */
+static bool
+map_segment (struct shm_segment *seg, void *addr) 
+{
+  struct thread *t = thread_current ();
+  uint8_t *upage = addr;
+  struct shm_attachment *a;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&shm_lock));
+
+  if (upage == NULL || pg_ofs (upage) != 0
+      || (uintptr_t) upage + seg->page_cnt * PGSIZE > (uintptr_t) PHYS_BASE
+      || (uintptr_t) upage + seg->page_cnt * PGSIZE < (uintptr_t) upage)
+    return false;
+  for (i = 0; i < seg->page_cnt; i++)
+    if (pagedir_get_page (t->pagedir, upage + i * PGSIZE) != NULL)
+      return false;
+#ifdef VM
+  for (i = 0; i < seg->page_cnt; i++)
+    if (page_lookup (upage + i * PGSIZE) != NULL)
+      return false;
+#endif
+
+  a = malloc (sizeof *a);
+  if (a == NULL)
+    return false;
+
+  for (i = 0; i < seg->page_cnt; i++)
+    if (!pagedir_set_shared_page (t->pagedir, upage + i * PGSIZE,
+                                  seg->frames[i], true))
+      {
+        while (i-- > 0)
+          pagedir_clear_page (t->pagedir, upage + i * PGSIZE);
+        free (a);
+        return false;
+      }
+
+  a->seg = seg;
+  a->addr = addr;
+  list_push_back (&t->shm_list, &a->elem);
+  seg->attach_cnt++;
+  return true;
+}
+
+/* Unmaps attachment A from the current process and frees it,
+   freeing its segment too if no attachments remain. */
+static void
+detach (struct shm_attachment *a) 
+{
+  struct thread *t = thread_current ();
+  struct shm_segment *seg = a->seg;
+  bool last;
+  size_t i;
+
+  for (i = 0; i < seg->page_cnt; i++)
+    pagedir_clear_page (t->pagedir, (uint8_t *) a->addr + i * PGSIZE);
+  list_remove (&a->elem);
+  free (a);
+
+  lock_acquire (&shm_lock);
+  last = --seg->attach_cnt == 0;
+  if (last)
+    {
+      list_remove (&seg->elem);
+      total_pages -= seg->page_cnt;
+    }
+  lock_release (&shm_lock);
+
+  if (last)
+    {
+      for (i = 0; i < seg->page_cnt; i++)
+        palloc_free_page (seg->frames[i]);
+      free (seg->frames);
+      free (seg);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef USERPROG_SHM_H
+#define USERPROG_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Most pages in one shared memory segment. */
+#define SHM_MAX_PAGES 256
+
+/* Most pages in all shared memory segments together. */
+#define SHM_TOTAL_PAGES 256
+
+struct thread;
+
+void shm_init (void);
+int shm_create (void *addr, size_t size);
+bool shm_attach (int id, void *addr);
+bool shm_detach (void *addr);
+void shm_exit (void);
+bool shm_fork (struct thread *parent);
+
+#endif /* userprog/shm.h */
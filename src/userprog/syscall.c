@@ -1,6 +1,13 @@
 #include "userprog/syscall.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
+#include "userprog/uaccess.h"
+#include "userprog/pipe.h"
+#include "userprog/shm.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 #include <stdio.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
@@ -10,6 +17,8 @@
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
 #include "threads/malloc.h"
+#include "devices/input.h"
+#include "devices/timer.h"
 
 #include "filesys/filesys.h"
 #include "filesys/file.h"
@@ -23,244 +32,785 @@
  
 static void syscall_handler (struct intr_frame *);
 //static void syscall_exit (int status);
-static bool syscall_create (char *file, off_t initial_size);
-static int syscall_open (char *file);
+static tid_t syscall_exec (const char *cmd_line);
+static tid_t syscall_fork (void);
+static bool syscall_create (const char *file, off_t initial_size);
+static int syscall_open (const char *file);
 static void syscall_close (int fd);
 static int syscall_read (int fd, void *buffer, unsigned length);
 static int syscall_filesize (int fd);
-static int syscall_write (int fd, void *buffer, unsigned size);
+static int syscall_write (int fd, const void *buffer, unsigned size);
 static bool syscall_remove (const char *file);
 static bool syscall_seem (const char *file);
 static void syscall_seek (int fd, unsigned position);
 static unsigned syscall_tell (int fd);
 
+static int syscall_mmap (int fd, void *addr);
+static void syscall_munmap (int mapping);
+
 static bool syscall_chdir(const char *file);
 static bool syscall_mkdir(const char *file);
 static bool syscall_readdir(int fd, char *file);
 static bool syscall_isdir(int fd);
+static int syscall_getdents (int fd, struct dirent *ents, unsigned size);
 static int syscall_inumber(int fd);
 
-static int get_user (const uint8_t *uaddr);
-static void is_valid_ptr (struct intr_frame *f UNUSED, void *uaddr);
+static int syscall_pread (int fd, void *buffer, unsigned length, unsigned offset);
+static int syscall_pwrite (int fd, const void *buffer, unsigned size, unsigned offset);
+static int syscall_readv (int fd, const struct iovec *iov, int iovcnt);
+static int syscall_writev (int fd, const struct iovec *iov, int iovcnt);
+
+static int syscall_stats (int kind, void *buffer, unsigned size);
+static struct ring *syscall_ring_setup (void *addr);
+static int syscall_ring_enter (unsigned to_submit);
+static int syscall_ttymode (int mode);
+static bool syscall_pipe (int *fds);
+static int stdin_read (void *buffer, unsigned length);
+
+static char *copy_in_string (const char *ustr);
+static int file_xfer (struct file *file, void *ubuf, unsigned size,
+                      off_t ofs, bool write);
+
+static int fd_alloc (struct file* file);
+static int fd_alloc_pipe (struct pipe *pipe, bool writer);
+static void fd_close (int fd);
+static struct fd_entry * fd_lookup (int fd);
+static struct fd_entry * fd_lookup_pipe (int fd);
+static int pipe_xfer (struct pipe *pipe, void *ubuf, unsigned size,
+                      bool write);
+
+/************************************************************
+*                  system call dispatch table.              *
+*************************************************************/
+
+/* Kinds of system call arguments. */
+enum arg_type
+  {
+    ARG_NONE,                   /* Not used. */
+    ARG_INT,                    /* Integer or user pointer, passed as is. */
+    ARG_STR                     /* User string, copied into a kernel page. */
+  };
+
+#define SYSCALL_ARG_MAX 4
 
-static int file_add_fdlist (struct file* file);
-static void file_remove_fdlist (int fd);
-static struct file_descriptor * fd_to_file_descriptor (int fd);
+/* Adapts a system call to the common calling convention: ARG
+   holds its arguments, already copied into the kernel, and the
+   return value goes to the user's EAX. */
+typedef uint32_t syscall_func (const uint32_t *arg);
 
-struct lock lock_file;
+/* A system call. */
+struct syscall
+  {
+    const char *name;                   /* Name, for statistics. */
+    syscall_func *func;                 /* Implementation. */
+    int arg_cnt;                        /* Number of arguments. */
+    enum arg_type types[SYSCALL_ARG_MAX]; /* Argument types. */
+  };
+
+static syscall_func sys_halt, sys_exit, sys_exec, sys_wait, sys_create,
+  sys_remove, sys_open, sys_filesize, sys_read, sys_write, sys_seek,
+  sys_tell, sys_close, sys_mmap, sys_munmap, sys_chdir, sys_mkdir,
+  sys_readdir, sys_isdir, sys_inumber, sys_pread, sys_pwrite, sys_readv,
+  sys_writev, sys_stats, sys_ring_setup, sys_ring_enter, sys_ttymode, sys_pipe,
+  sys_shm_create, sys_shm_attach, sys_shm_detach, sys_getdents, sys_fork;
+
+static const struct syscall syscalls[] =
+  {
+    [SYS_HALT] =     {"halt", sys_halt, 0, {}},
+    [SYS_EXIT] =     {"exit", sys_exit, 1, {ARG_INT}},
+    [SYS_EXEC] =     {"exec", sys_exec, 1, {ARG_STR}},
+    [SYS_WAIT] =     {"wait", sys_wait, 1, {ARG_INT}},
+    [SYS_CREATE] =   {"create", sys_create, 2, {ARG_STR, ARG_INT}},
+    [SYS_REMOVE] =   {"remove", sys_remove, 1, {ARG_STR}},
+    [SYS_OPEN] =     {"open", sys_open, 1, {ARG_STR}},
+    [SYS_FILESIZE] = {"filesize", sys_filesize, 1, {ARG_INT}},
+    [SYS_READ] =     {"read", sys_read, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_WRITE] =    {"write", sys_write, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_SEEK] =     {"seek", sys_seek, 2, {ARG_INT, ARG_INT}},
+    [SYS_TELL] =     {"tell", sys_tell, 1, {ARG_INT}},
+    [SYS_CLOSE] =    {"close", sys_close, 1, {ARG_INT}},
+    [SYS_MMAP] =     {"mmap", sys_mmap, 2, {ARG_INT, ARG_INT}},
+    [SYS_MUNMAP] =   {"munmap", sys_munmap, 1, {ARG_INT}},
+    [SYS_CHDIR] =    {"chdir", sys_chdir, 1, {ARG_STR}},
+    [SYS_MKDIR] =    {"mkdir", sys_mkdir, 1, {ARG_STR}},
+    [SYS_READDIR] =  {"readdir", sys_readdir, 2, {ARG_INT, ARG_INT}},
+    [SYS_ISDIR] =    {"isdir", sys_isdir, 1, {ARG_INT}},
+    [SYS_INUMBER] =  {"inumber", sys_inumber, 1, {ARG_INT}},
+    [SYS_PREAD] =    {"pread", sys_pread, 4,
+                      {ARG_INT, ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_PWRITE] =   {"pwrite", sys_pwrite, 4,
+                      {ARG_INT, ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_READV] =    {"readv", sys_readv, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_WRITEV] =   {"writev", sys_writev, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_STATS] =    {"stats", sys_stats, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_RING_SETUP] = {"ring_setup", sys_ring_setup, 1, {ARG_INT}},
+    [SYS_RING_ENTER] = {"ring_enter", sys_ring_enter, 1, {ARG_INT}},
+    [SYS_TTYMODE] =  {"ttymode", sys_ttymode, 1, {ARG_INT}},
+    [SYS_PIPE] =     {"pipe", sys_pipe, 1, {ARG_INT}},
+    [SYS_SHM_CREATE] = {"shm_create", sys_shm_create, 2, {ARG_INT, ARG_INT}},
+    [SYS_SHM_ATTACH] = {"shm_attach", sys_shm_attach, 2, {ARG_INT, ARG_INT}},
+    [SYS_SHM_DETACH] = {"shm_detach", sys_shm_detach, 1, {ARG_INT}},
+    [SYS_GETDENTS] = {"getdents", sys_getdents, 3, {ARG_INT, ARG_INT, ARG_INT}},
+    [SYS_FORK] =     {"fork", sys_fork, 0, {}},
+  };
+
+#define SYSCALL_CNT (sizeof syscalls / sizeof *syscalls)
+
+/* Statistics for each system call number.  Updated with
+   interrupts off. */
+static struct syscall_stat syscall_stats_table[SYSCALL_CNT];
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init (&lock_file);
+  shm_init ();
+}
+
+/* Returns the current value of the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
-  //struct thread* curr = thread_current();
-  int *syscall_nr = (int *)(f->esp);
+  const struct syscall *sc;
+  struct syscall_stat *st;
+  uint32_t arg[SYSCALL_ARG_MAX];
+  char *str = NULL;
+  int64_t start_ticks;
+  uint64_t start_tsc;
+  enum intr_level old_level;
+  int syscall_nr;
   int i;
 
-  //Check whether stack pointer exceed PHYS_BASE
-  for(i = 0; i < 4; i++){ //Argument of syscall is no more than 3
-    if( ( get_user((uint8_t *)syscall_nr + 4 * i ) == -1 )
-        || is_kernel_vaddr ((void *)((uint8_t *)syscall_nr + 4 * i)) ){
-      syscall_exit(EXIT_STATUS_1);
-    }
+  /* Every user pointer, including the stack pointer itself, goes
+     through the copy routines in userprog/uaccess.c, which exit
+     the process on a bad address via syscall_exit(-1).  Only the
+     arguments the call actually takes are copied in. */
+#ifdef VM
+  thread_current ()->syscall_frame = f;
+#endif
+  if (!copy_from_user (&syscall_nr, f->esp, sizeof syscall_nr))
+    syscall_exit(EXIT_STATUS_1);
+  if (syscall_nr < 0 || (size_t) syscall_nr >= SYSCALL_CNT
+      || syscalls[syscall_nr].func == NULL)
+  {
+    f->eax = (uint32_t) -1;
+#ifdef VM
+    thread_current ()->syscall_frame = NULL;
+#endif
+    return;
   }
+  sc = &syscalls[syscall_nr];
+  st = &syscall_stats_table[syscall_nr];
 
-  void **arg1 = (void **)(syscall_nr+1);
-  void **arg2 = (void **)(syscall_nr+2);
-  void **arg3 = (void **)(syscall_nr+3);
-  //void **arg4 = (void **)(syscall_nr+4);
+  old_level = intr_disable ();
+  st->count++;
+  intr_set_level (old_level);
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
 
-  switch (*syscall_nr) {
-    case SYS_HALT: //0
-      power_off();
-      break;
-    case SYS_EXIT: //1
-      syscall_exit((int)*arg1);
-      break;
-    case SYS_EXEC: //2
-      is_valid_ptr(f, *(void **)arg1);
-      f->eax = (uint32_t) process_execute(*(char **)arg1);
-      break;
-    case SYS_WAIT: //3
-      f->eax = (uint32_t) process_wait(*(tid_t *)arg1);
-      break; 
-    case SYS_CREATE: //4
-      is_valid_ptr(f, *(void **)arg1);
-      f->eax = (uint32_t) syscall_create(*(char **)arg1, (off_t)*arg2);
-      break;
-    case SYS_REMOVE: //5
-      f->eax = (uint32_t) syscall_remove (*(char **)arg1);
-      break;
-    case SYS_OPEN: //6
-      is_valid_ptr(f, *(void **)arg1);
-      f->eax = (uint32_t) syscall_open(*(char **)arg1);
-      break;
-    case SYS_FILESIZE: //7
-      f->eax = (uint32_t) syscall_filesize((int)*arg1);
-      break;
-    case SYS_READ: //8
-      is_valid_ptr(f, *(void **)arg2);
-      f->eax = (uint32_t) syscall_read((int)*arg1, *(void **)arg2, (unsigned)*arg3);
-      break;
-    case SYS_WRITE: //9
-      is_valid_ptr(f, *(void **)arg2);
-      if((int)*arg1 == 0) syscall_exit(EXIT_STATUS_1); //STDIN은 exit/ todo: valid ptr 안에 집어넣기
-      f->eax = (uint32_t) syscall_write ((int)*arg1, *(void **)arg2, (unsigned)*arg3);
-      break;
-    case SYS_SEEK:
-      syscall_seek ((int)*arg1, (unsigned)*arg2);
-      break;
-    case SYS_TELL:
-      f->eax = (uint32_t) syscall_tell ((int)*arg1);
-      break;
-    case SYS_CLOSE:
-      syscall_close((int)*arg1);
-      break;
-/* ---------------------------------------------------------------------*/
-/* 
- * Haney: No need to implement below since we are working on project 2
- */
-    case SYS_MMAP:
-      // Not implemented yet
-      break;
-    case SYS_MUNMAP:
-      // Not implemented yet
-      break;
-    case SYS_CHDIR:
-      is_valid_ptr(f, *(void **)arg1);
-      f->eax = (uint32_t) syscall_chdir (*(char **)arg1);
-      break;
-    case SYS_MKDIR:
-      is_valid_ptr(f, *(void **)arg1);
-      f->eax = (uint32_t) syscall_mkdir (*(char **)arg1);
-      break;
-    case SYS_READDIR: 
-      // Not implemented yet
-      is_valid_ptr(f, *(void **)arg2);
-      f->eax = (uint32_t) syscall_readdir ((int)*arg1, *(char **)arg2);
-      break;
-    case SYS_ISDIR:
-      // Not implemented yet
-      f->eax = (uint32_t) syscall_isdir ((int)*arg1);
-      break;
-    case SYS_INUMBER:
-      // Not implemented yet
-      f->eax = (uint32_t) syscall_inumber ((int)*arg1);
-      break;
-/* ---------------------------------------------------------------------*/
-    default:
-      break;
-  }
+  if (!copy_from_user (arg, (uint32_t *) f->esp + 1,
+                       sc->arg_cnt * sizeof *arg))
+    syscall_exit(EXIT_STATUS_1);
+  for (i = 0; i < sc->arg_cnt; i++)
+    if (sc->types[i] == ARG_STR)
+    {
+      /* A string too long for a page is passed as NULL, which
+         the call reports as its usual failure. */
+      str = copy_in_string ((const char *) arg[i]);
+      arg[i] = (uint32_t) str;
+    }
+
+  f->eax = sc->func (arg);
+  palloc_free_page (str);
+
+  old_level = intr_disable ();
+  st->ticks += timer_ticks () - start_ticks;
+  st->cycles += rdtsc () - start_tsc;
+  intr_set_level (old_level);
+#ifdef VM
+  thread_current ()->syscall_frame = NULL;
+#endif
 }
 
-static int get_user (const uint8_t *uaddr){
-  int result;
-  asm ("movl $1f, %0; movzbl %1, %0; 1:"
-      : "=&a" (result) : "m" (*uaddr));
-  return result;
+/* Prints system call statistics. */
+void
+syscall_print_stats (void)
+{
+  size_t i;
+
+  for (i = 0; i < SYSCALL_CNT; i++)
+    if (syscall_stats_table[i].count > 0)
+      printf ("Syscall %s: %u calls, %llu ticks, %llu cycles\n",
+              syscalls[i].name, syscall_stats_table[i].count,
+              syscall_stats_table[i].ticks, syscall_stats_table[i].cycles);
 }
 
-/* Handle invalid memory access:
-   exit(-1) when UADDR is kernel vaddr or unmapped to pagedir of current process */
+static uint32_t
+sys_halt (const uint32_t *arg UNUSED)
+{
+  power_off();
+}
 
-static void
-is_valid_ptr(struct intr_frame *f UNUSED, void *uaddr)
+static uint32_t
+sys_exit (const uint32_t *arg)
 {
-  if (is_kernel_vaddr(uaddr))
-    syscall_exit(EXIT_STATUS_1);
+  syscall_exit((int)arg[0]);
+  NOT_REACHED ();
+}
+
+static uint32_t
+sys_exec (const uint32_t *arg)
+{
+  return (uint32_t) syscall_exec ((const char *)arg[0]);
+}
+
+static uint32_t
+sys_fork (const uint32_t *arg UNUSED)
+{
+  return (uint32_t) syscall_fork ();
+}
+
+static uint32_t
+sys_wait (const uint32_t *arg)
+{
+  return (uint32_t) process_wait((tid_t)arg[0]);
+}
+
+static uint32_t
+sys_create (const uint32_t *arg)
+{
+  return (uint32_t) syscall_create((const char *)arg[0], (off_t)arg[1]);
+}
+
+static uint32_t
+sys_remove (const uint32_t *arg)
+{
+  return (uint32_t) syscall_remove ((const char *)arg[0]);
+}
+
+static uint32_t
+sys_open (const uint32_t *arg)
+{
+  return (uint32_t) syscall_open((const char *)arg[0]);
+}
 
-  struct thread* curr = thread_current ();
-  uint32_t *pd = curr->pagedir;
-  uint32_t *is_bad_ptr = pagedir_get_page (pd, uaddr);
-  
-  if(is_bad_ptr == NULL)
+static uint32_t
+sys_filesize (const uint32_t *arg)
+{
+  return (uint32_t) syscall_filesize((int)arg[0]);
+}
+
+static uint32_t
+sys_read (const uint32_t *arg)
+{
+  return (uint32_t) syscall_read((int)arg[0], (void *)arg[1], (unsigned)arg[2]);
+}
+
+static uint32_t
+sys_write (const uint32_t *arg)
+{
+  if((int)arg[0] == 0) syscall_exit(EXIT_STATUS_1); //STDIN은 exit
+  return (uint32_t) syscall_write ((int)arg[0], (const void *)arg[1], (unsigned)arg[2]);
+}
+
+static uint32_t
+sys_seek (const uint32_t *arg)
+{
+  syscall_seek ((int)arg[0], (unsigned)arg[1]);
+  return 0;
+}
+
+static uint32_t
+sys_tell (const uint32_t *arg)
+{
+  return (uint32_t) syscall_tell ((int)arg[0]);
+}
+
+static uint32_t
+sys_close (const uint32_t *arg)
+{
+  syscall_close((int)arg[0]);
+  return 0;
+}
+
+static uint32_t
+sys_mmap (const uint32_t *arg)
+{
+  return (uint32_t) syscall_mmap ((int)arg[0], (void *)arg[1]);
+}
+
+static uint32_t
+sys_munmap (const uint32_t *arg)
+{
+  syscall_munmap ((int)arg[0]);
+  return 0;
+}
+
+static uint32_t
+sys_chdir (const uint32_t *arg)
+{
+  return (uint32_t) syscall_chdir ((const char *)arg[0]);
+}
+
+static uint32_t
+sys_mkdir (const uint32_t *arg)
+{
+  return (uint32_t) syscall_mkdir ((const char *)arg[0]);
+}
+
+static uint32_t
+sys_readdir (const uint32_t *arg)
+{
+  return (uint32_t) syscall_readdir ((int)arg[0], (char *)arg[1]);
+}
+
+static uint32_t
+sys_getdents (const uint32_t *arg)
+{
+  return (uint32_t) syscall_getdents ((int)arg[0], (struct dirent *)arg[1],
+                                      (unsigned)arg[2]);
+}
+
+static uint32_t
+sys_isdir (const uint32_t *arg)
+{
+  return (uint32_t) syscall_isdir ((int)arg[0]);
+}
+
+static uint32_t
+sys_inumber (const uint32_t *arg)
+{
+  return (uint32_t) syscall_inumber ((int)arg[0]);
+}
+
+static uint32_t
+sys_pread (const uint32_t *arg)
+{
+  return (uint32_t) syscall_pread ((int)arg[0], (void *)arg[1],
+                                   (unsigned)arg[2], (unsigned)arg[3]);
+}
+
+static uint32_t
+sys_pwrite (const uint32_t *arg)
+{
+  return (uint32_t) syscall_pwrite ((int)arg[0], (const void *)arg[1],
+                                    (unsigned)arg[2], (unsigned)arg[3]);
+}
+
+static uint32_t
+sys_readv (const uint32_t *arg)
+{
+  return (uint32_t) syscall_readv ((int)arg[0], (const struct iovec *)arg[1],
+                                   (int)arg[2]);
+}
+
+static uint32_t
+sys_writev (const uint32_t *arg)
+{
+  return (uint32_t) syscall_writev ((int)arg[0], (const struct iovec *)arg[1],
+                                    (int)arg[2]);
+}
+
+static uint32_t
+sys_stats (const uint32_t *arg)
+{
+  return (uint32_t) syscall_stats ((int)arg[0], (void *)arg[1],
+                                   (unsigned)arg[2]);
+}
+
+static uint32_t
+sys_ring_setup (const uint32_t *arg)
+{
+  return (uint32_t) syscall_ring_setup ((void *)arg[0]);
+}
+
+static uint32_t
+sys_ring_enter (const uint32_t *arg)
+{
+  return (uint32_t) syscall_ring_enter ((unsigned)arg[0]);
+}
+
+static uint32_t
+sys_ttymode (const uint32_t *arg)
+{
+  return (uint32_t) syscall_ttymode ((int)arg[0]);
+}
+
+static uint32_t
+sys_pipe (const uint32_t *arg)
+{
+  return (uint32_t) syscall_pipe ((int *)arg[0]);
+}
+
+static uint32_t
+sys_shm_create (const uint32_t *arg)
+{
+  return (uint32_t) shm_create ((void *)arg[0], (size_t)arg[1]);
+}
+
+static uint32_t
+sys_shm_attach (const uint32_t *arg)
+{
+  return (uint32_t) shm_attach ((int)arg[0], (void *)arg[1]);
+}
+
+static uint32_t
+sys_shm_detach (const uint32_t *arg)
+{
+  return (uint32_t) shm_detach ((void *)arg[0]);
+}
+
+/************************************************************
+*          functions for copying in user arguments.         *
+*************************************************************/
+
+/* Copies the user string USTR into a newly allocated page and
+   returns it; the caller must free it with palloc_free_page().
+   Returns NULL if USTR does not fit in a page or memory is
+   short.  Exits the process if USTR is not valid user memory. */
+static char *
+copy_in_string (const char *ustr)
+{
+  char *kstr = palloc_get_page (0);
+  int len;
+
+  if (kstr == NULL)
+    return NULL;
+
+  len = strncpy_from_user (kstr, ustr, PGSIZE);
+  if (len < 0)
+  {
+    palloc_free_page (kstr);
     syscall_exit(EXIT_STATUS_1);
+  }
+  if (len == PGSIZE)
+  {
+    palloc_free_page (kstr);
+    return NULL;
+  }
+  return kstr;
+}
+
+/* Transfers SIZE bytes between FILE and the user buffer UBUF one
+   page at a time through a kernel bounce page, writing to FILE
+   if WRITE is true and reading from it otherwise.  A null FILE
+   writes to the console.  Uses offset OFS, or the file position
+   if OFS is negative.  Returns the number of bytes transferred,
+   or -1 if memory is short.  Exits the process if UBUF is not
+   valid user memory. */
+static int
+file_xfer (struct file *file, void *ubuf, unsigned size, off_t ofs,
+           bool write)
+{
+  uint8_t *page;
+  unsigned done = 0;
+
+  if (size == 0)
+    return 0;
+
+  page = palloc_get_page (0);
+  if (page == NULL)
+    return -1;
+
+  while (done < size)
+  {
+    uint8_t *uaddr = (uint8_t *) ubuf + done;
+    unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+    off_t result;
+
+    if (write)
+    {
+      if (!copy_from_user (page, uaddr, chunk))
+        goto fault;
+      if (file == NULL)
+      {
+        putbuf ((const char *) page, chunk);
+        result = chunk;
+      }
+      else if (ofs < 0)
+        result = file_write (file, page, chunk);
+      else
+        result = file_write_at (file, page, chunk, ofs + done);
+    }
+    else
+    {
+      if (ofs < 0)
+        result = file_read (file, page, chunk);
+      else
+        result = file_read_at (file, page, chunk, ofs + done);
+      if (!copy_to_user (uaddr, page, result))
+        goto fault;
+    }
+
+    done += result;
+    if ((unsigned) result < chunk)
+      break;
+  }
+
+  palloc_free_page (page);
+  return done;
+
+ fault:
+  palloc_free_page (page);
+  syscall_exit(EXIT_STATUS_1);
+  NOT_REACHED ();
 }
 
 /************************************************************
 *      struct and function for file descriptor table.       *
 *************************************************************/
 
-struct file_descriptor
+/* Each process keeps its open files in an array indexed by
+   file descriptor, so looking one up is a bounds check plus an
+   index.  The array doubles as needed, up to FD_MAX slots.  New
+   descriptors take the lowest free slot, scanning upward from
+   fd_free, below which every slot is known to be in use. */
+
+#define FD_MIN 2                /* 0, 1: STDIN, STDOUT. */
+#define FD_INIT_CAP 16
+#define FD_MAX 1024
+
+struct fd_entry
 {
-  int fd;
-  struct file* file;
-  struct dir* dir;
-  struct list_elem elem;
+  struct file* file;            /* Open file, or NULL. */
+  struct dir* dir;              /* Directory handle for readdir. */
+  struct pipe* pipe;            /* Pipe end, or NULL. */
+  bool writer;                  /* True for a pipe's write end. */
 };
 
+/* Returns true if descriptor table entry E is in use. */
+static bool
+fd_in_use (const struct fd_entry *e)
+{
+  return e->file != NULL || e->pipe != NULL;
+}
+
+/* Grows T's table to at least CAP slots.  Returns true if
+   successful, false if CAP exceeds FD_MAX or memory is short. */
+static bool
+fd_grow (struct thread *t, int cap)
+{
+  int new_cap = t->fd_cap == 0 ? FD_INIT_CAP : t->fd_cap;
+  struct fd_entry *table;
+
+  if (cap <= t->fd_cap)
+    return true;
+  if (cap > FD_MAX)
+    return false;
+  while (new_cap < cap)
+    new_cap *= 2;
+  if (new_cap > FD_MAX)
+    new_cap = FD_MAX;
+
+  table = realloc (t->fd_table, new_cap * sizeof *table);
+  if (table == NULL)
+    return false;
+  memset (table + t->fd_cap, 0, (new_cap - t->fd_cap) * sizeof *table);
+  t->fd_table = table;
+  t->fd_cap = new_cap;
+  return true;
+}
+
+/* Returns the lowest free slot in the current process's table,
+   growing it if necessary, or -1 if the table is full or cannot
+   grow. */
+static int
+fd_alloc_slot (void)
+{
+  struct thread *curr = thread_current ();
+  int fd;
+
+  for (fd = curr->fd_free; fd < curr->fd_cap; fd++)
+    if (!fd_in_use (&curr->fd_table[fd]))
+      break;
+
+  if (fd == curr->fd_cap && !fd_grow (curr, fd + 1))
+    return -1;
+  curr->fd_free = fd + 1;
+  return fd;
+}
+
+/* Installs FILE in the lowest free slot of the current process's
+   table and returns its descriptor, or -1 if the table is full
+   or cannot grow. */
 static int
-file_add_fdlist (struct file* file)
+fd_alloc (struct file* file)
 {
   struct thread *curr = thread_current ();
-  struct file_descriptor *desc = malloc(sizeof *desc);
+  struct inode *inode = file_get_inode (file);
+  int fd = fd_alloc_slot ();
+
+  if (fd < 0)
+    return -1;
 
-  curr->fd++;
+  curr->fd_table[fd].file = file;
+  curr->fd_table[fd].dir = NULL;
+  if (inode_is_directory (inode))
+    curr->fd_table[fd].dir = dir_open (inode_reopen (inode));
 
-  desc->fd = curr->fd;
-  desc->file = file;
+  return fd;
+}
 
-  list_push_back (&curr->fd_list, &desc->elem);
+/* Opens an end of PIPE, the write end if WRITER, in the lowest
+   free slot of the current process's table and returns its
+   descriptor, or -1 if the table is full or cannot grow. */
+static int
+fd_alloc_pipe (struct pipe *pipe, bool writer)
+{
+  struct thread *curr = thread_current ();
+  int fd = fd_alloc_slot ();
+
+  if (fd < 0)
+    return -1;
 
-  return curr->fd;
+  pipe_open (pipe, writer);
+  curr->fd_table[fd].pipe = pipe;
+  curr->fd_table[fd].writer = writer;
+
+  return fd;
 }
 
+/* Closes descriptor FD of the current process, if open. */
 static void
-file_remove_fdlist (int fd)
+fd_close (int fd)
 {
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+  struct thread *curr = thread_current ();
+  struct fd_entry *desc;
 
-  if (desc == NULL)
+  if (fd < FD_MIN || fd >= curr->fd_cap
+      || !fd_in_use (&curr->fd_table[fd]))
     return;
 
+  desc = &curr->fd_table[fd];
   file_close (desc->file);
-  list_remove (&desc->elem);
-  free (desc);
+  dir_close (desc->dir);
+  if (desc->pipe != NULL)
+    pipe_close (desc->pipe, desc->writer);
+  memset (desc, 0, sizeof *desc);
+  if (fd < curr->fd_free)
+    curr->fd_free = fd;
+}
+
+/* Returns the table entry for descriptor FD of the current
+   process, or NULL if FD is not an open file. */
+static struct fd_entry *
+fd_lookup (int fd)
+{
+  struct thread *curr = thread_current ();
+
+  if (fd < FD_MIN || fd >= curr->fd_cap
+      || curr->fd_table[fd].file == NULL)
+    return NULL;
+  return &curr->fd_table[fd];
+}
+
+/* Returns the table entry for descriptor FD of the current
+   process, or NULL if FD is not an open pipe end. */
+static struct fd_entry *
+fd_lookup_pipe (int fd)
+{
+  struct thread *curr = thread_current ();
+
+  if (fd < FD_MIN || fd >= curr->fd_cap
+      || curr->fd_table[fd].pipe == NULL)
+    return NULL;
+  return &curr->fd_table[fd];
 }
 
-static struct file_descriptor *
-fd_to_file_descriptor (int fd)
+/* Gives the current process, which PARENT has just started with
+   exec(), its own reference to each of PARENT's pipe ends, at
+   the same descriptor numbers.  Unlike files, pipes are useless
+   unless inherited.  PARENT must be blocked in exec(). */
+void
+fd_inherit_pipes (struct thread *parent)
 {
   struct thread *curr = thread_current ();
-  struct list_elem *iter;
-  struct file_descriptor *desc;
+  int fd;
 
-  for (iter = list_begin (&curr->fd_list); iter != list_end (&curr->fd_list); iter = list_next (iter))
+  for (fd = FD_MIN; fd < parent->fd_cap; fd++)
   {
-    desc = list_entry(iter, struct file_descriptor, elem);
-    if (desc->fd == fd)
-      return desc;
+    struct fd_entry *e = &parent->fd_table[fd];
+
+    if (e->pipe == NULL || !fd_grow (curr, fd + 1))
+      continue;
+    pipe_open (e->pipe, e->writer);
+    curr->fd_table[fd].pipe = e->pipe;
+    curr->fd_table[fd].writer = e->writer;
   }
-  return NULL;
 }
 
+/* Closes every descriptor of T and frees its table. */
 static void
-process_remove_fdlist (struct thread* t)
+fd_table_destroy (struct thread* t)
 {
-  struct list_elem *iter, *iter_2;
-  struct file_descriptor *desc;
-
-  if(list_empty(&t->fd_list))
-    return;
+  int fd;
 
-  while((iter = list_begin (&t->fd_list)) != list_end (&t->fd_list))
+  for (fd = FD_MIN; fd < t->fd_cap; fd++)
   {
-    iter_2 = list_next (iter);
+    struct fd_entry *e = &t->fd_table[fd];
+
+    file_close (e->file);
+    dir_close (e->dir);
+    if (e->pipe != NULL)
+      pipe_close (e->pipe, e->writer);
+  }
 
-    desc = list_entry(iter, struct file_descriptor, elem);
+  free (t->fd_table);
+  t->fd_table = NULL;
+  t->fd_cap = 0;
+  t->fd_free = FD_MIN;
+}
 
-    file_close (desc->file);
-    list_remove (&desc->elem);
-    free(desc);
+/* Gives the current process, which PARENT has just created with
+   fork(), its own copy of each of PARENT's descriptors at the
+   same number.  Files are reopened at the same position, though
+   from then on the two positions move independently; pipe ends
+   gain a reference.  PARENT must be blocked in fork().  Returns
+   true if successful, false if memory is short, in which case
+   nothing is left open. */
+bool
+fd_fork (struct thread *parent)
+{
+  struct thread *curr = thread_current ();
+  int fd;
 
-    iter = iter_2;
+  if (!fd_grow (curr, parent->fd_cap))
+    return false;
+  for (fd = FD_MIN; fd < parent->fd_cap; fd++)
+  {
+    struct fd_entry *e = &parent->fd_table[fd];
+    struct fd_entry *c = &curr->fd_table[fd];
+
+    if (e->file != NULL)
+    {
+      c->file = file_reopen (e->file);
+      if (c->file == NULL)
+        goto fail;
+      file_seek (c->file, file_tell (e->file));
+      if (e->dir != NULL && (c->dir = dir_reopen (e->dir)) == NULL)
+        goto fail;
+    }
+    if (e->pipe != NULL)
+    {
+      pipe_open (e->pipe, e->writer);
+      c->pipe = e->pipe;
+      c->writer = e->writer;
+    }
   }
+  curr->fd_free = parent->fd_free;
+  return true;
+
+ fail:
+  fd_table_destroy (curr);
+  return false;
 }
 
 /************************************************************
@@ -274,7 +824,10 @@ syscall_exit (int status)
   struct thread *parent = curr->parent;
   struct list_elem* e;
   struct child *child_process;
- 
+
+#ifdef VM
+  curr->syscall_frame = NULL;
+#endif
   for(e = list_begin(&parent->child);
       e != list_end (&parent->child);
       e = list_next (e))
@@ -283,7 +836,7 @@ syscall_exit (int status)
     if (child_process->tid == curr->tid){
       child_process->exit_stat = status;
 
-      process_remove_fdlist(curr);
+      fd_table_destroy(curr);
 
       char* save_ptr;
       strtok_r (&curr->name," ", &save_ptr);
@@ -297,222 +850,654 @@ syscall_exit (int status)
   NOT_REACHED();
 }
 
+/* String arguments below have already been copied into the
+   kernel by syscall_handler(), and are NULL if too long. */
+
+static tid_t
+syscall_exec (const char *cmd_line)
+{
+  if (cmd_line == NULL)
+    return TID_ERROR;
+
+  return process_execute (cmd_line);
+}
+
+/* Copies the current process.  Copy-on-write needs the
+   supplemental page table, so without VM this always fails. */
+static tid_t
+syscall_fork (void)
+{
+#ifdef VM
+  return process_fork (thread_current ()->syscall_frame);
+#else
+  return TID_ERROR;
+#endif
+}
+
 static bool
-syscall_create (char *file, off_t initial_size)
+syscall_create (const char *file, off_t initial_size)
 {
-  return filesys_create (file, initial_size, false);
+  return file != NULL && filesys_create (file, initial_size, false);
 }
 
 static int
-syscall_open (char *file)
+syscall_open (const char *file)
 {
-  lock_acquire(&lock_file);
-  struct file* opened_file = filesys_open (file);
+  struct file* opened_file;
+  int fd;
 
+  if (file == NULL)
+    return -1;
+
+  opened_file = filesys_open (file);
   if (opened_file == NULL)
     return -1;
 
-  int result = file_add_fdlist(opened_file);
-  lock_release(&lock_file);
-  return result;
+  fd = fd_alloc (opened_file);
+  if (fd < 0)
+    file_close (opened_file);
+  return fd;
 }
 
 static void
 syscall_close (int fd)
 {
-  lock_acquire(&lock_file);
-  file_remove_fdlist (fd);
-  lock_release(&lock_file);
+  fd_close (fd);
 }
 
 static int
 syscall_read (int fd, void *buffer, unsigned length)
 {
   if (fd == 0) /* STDIN */
-    return input_getc();
+    return stdin_read (buffer, length);
 
-  lock_acquire(&lock_file);
+  struct fd_entry *desc = fd_lookup_pipe (fd);
+  if (desc != NULL)
+    return desc->writer ? -1 : pipe_xfer (desc->pipe, buffer, length, false);
 
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+  desc = fd_lookup (fd);
 
   if (desc == NULL)
-  {
-    lock_release(&lock_file);
     return -1;
-  }
 
-  int result = file_read (desc->file, buffer, length);
-
-  lock_release(&lock_file);
-  return result;
+  return file_xfer (desc->file, buffer, length, -1, false);
 }
 
 static int
 syscall_filesize (int fd)
 {
-  lock_acquire(&lock_file);
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
-  int result = file_length(desc->file);
+  struct fd_entry *desc = fd_lookup (fd);
+
+  if (desc == NULL)
+    return -1;
 
-  lock_release(&lock_file);
-  return result;
+  return file_length(desc->file);
 }
 
 static int
-syscall_write (int fd, void *buffer, unsigned size)
+syscall_write (int fd, const void *buffer, unsigned size)
 {
   if (fd == 1) /* STDOUT */
-  {
-    putbuf (buffer, size);
-    return size;
-  }
+    return file_xfer (NULL, (void *) buffer, size, -1, true);
 
-  lock_acquire(&lock_file);
+  struct fd_entry *desc = fd_lookup_pipe (fd);
+  if (desc != NULL)
+    return desc->writer ? pipe_xfer (desc->pipe, (void *) buffer, size, true) : -1;
 
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+  desc = fd_lookup (fd);
 
   if (desc == NULL)
-  {
-    lock_release(&lock_file);
     return -1;
-  }
 
   bool is_dir = inode_is_directory (file_get_inode(desc->file));
   if (is_dir)
-  {
-    lock_release(&lock_file);
     return -1;
-  }
 
-  int result = file_write (desc->file, buffer, size);
-
-  lock_release(&lock_file);
-  return result;
+  return file_xfer (desc->file, (void *) buffer, size, -1, true);
 }
 
 static bool
 syscall_remove (const char *file)
 {
-  lock_acquire(&lock_file);
-  bool result = filesys_remove (file);
-  lock_release(&lock_file);
-
-  return result;
+  return file != NULL && filesys_remove (file);
 }
 
 static void
 syscall_seek (int fd, unsigned position)
 {
-  lock_acquire(&lock_file);
-
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+  struct fd_entry *desc = fd_lookup (fd);
 
   if (desc == NULL)
-  {
-    lock_release(&lock_file);
-  }
+    return;
 
   file_seek (desc->file, position);
-  lock_release(&lock_file);
 }
 
 static unsigned
 syscall_tell (int fd)
 {
-  lock_acquire(&lock_file);
-
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+  struct fd_entry *desc = fd_lookup (fd);
 
   if (desc == NULL)
-  {
-    lock_release(&lock_file);
     return 0; //todo: error handling right?
+
+  return file_tell (desc->file);
+}
+
+/* Reads up to LENGTH bytes of console input into user BUFFER,
+   returning as soon as some input is available, or a whole line
+   in canonical mode.  Returns the number of bytes read. */
+static int
+stdin_read (void *buffer, unsigned length)
+{
+  uint8_t *page;
+  size_t n;
+
+  if (length == 0)
+    return 0;
+
+  page = palloc_get_page (0);
+  if (page == NULL)
+    return -1;
+
+  n = input_read (page, length < PGSIZE ? length : PGSIZE);
+  if (!copy_to_user (buffer, page, n))
+  {
+    palloc_free_page (page);
+    syscall_exit(EXIT_STATUS_1);
   }
+  palloc_free_page (page);
+  return n;
+}
 
-  unsigned result = file_tell (desc->file);
-  lock_release(&lock_file);
+/* Sets console input to MODE, TTY_RAW or TTY_CANON.  Returns the
+   previous mode, or -1 if MODE is invalid. */
+static int
+syscall_ttymode (int mode)
+{
+  if (mode != TTY_RAW && mode != TTY_CANON)
+    return -1;
 
-  return result;
+  return input_set_canonical (mode == TTY_CANON) ? TTY_CANON : TTY_RAW;
 }
 
-/*----------- FILE SYSTEM -------------------*/
+/*----------- PIPES -------------------*/
 
+/* Creates a pipe and stores descriptors for its read and write
+   ends in user array FDS.  Returns true if successful. */
 static bool
-syscall_chdir(const char *file)
+syscall_pipe (int *fds)
 {
-  bool return_code;
+  struct pipe *pipe = pipe_create ();
+  int kfds[2];
+
+  if (pipe == NULL)
+    return false;
 
-  lock_acquire (&lock_file);
-  return_code = filesys_chdir(file);
-  lock_release (&lock_file);
+  /* Hold an extra read end while allocating descriptors, so that
+     closing it at the end frees the pipe if they failed. */
+  pipe_open (pipe, false);
+  kfds[0] = fd_alloc_pipe (pipe, false);
+  kfds[1] = kfds[0] < 0 ? -1 : fd_alloc_pipe (pipe, true);
+  if (kfds[1] < 0 && kfds[0] >= 0)
+    fd_close (kfds[0]);
+  pipe_close (pipe, false);
+  if (kfds[1] < 0)
+    return false;
 
-  return return_code;
+  if (!copy_to_user (fds, kfds, sizeof kfds))
+    syscall_exit(EXIT_STATUS_1);
+  return true;
 }
 
-static bool
-syscall_mkdir(const char *file)
+/* Transfers SIZE bytes between PIPE and the user buffer UBUF
+   through a kernel bounce page, writing to PIPE if WRITE is true
+   and reading from it otherwise.  A read returns as soon as any
+   data arrives.  Returns the number of bytes transferred, or -1
+   on failure.  Exits the process if UBUF is not valid user
+   memory. */
+static int
+pipe_xfer (struct pipe *pipe, void *ubuf, unsigned size, bool write)
 {
-  bool return_code;
+  uint8_t *page;
+  unsigned done = 0;
+
+  if (size == 0)
+    return 0;
+
+  page = palloc_get_page (0);
+  if (page == NULL)
+    return -1;
 
-  lock_acquire (&lock_file);
-  return_code = filesys_create(file, 0, true);
-  lock_release (&lock_file);
+  if (!write)
+  {
+    int n = pipe_read (pipe, page, size < PGSIZE ? size : PGSIZE);
+    if (!copy_to_user (ubuf, page, n))
+      goto fault;
+    done = n;
+  }
+  else
+    while (done < size)
+    {
+      unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+      int n;
+
+      if (!copy_from_user (page, (uint8_t *) ubuf + done, chunk))
+        goto fault;
+      n = pipe_write (pipe, page, chunk);
+      if (n < 0 && done == 0)
+      {
+        palloc_free_page (page);
+        return -1;
+      }
+      if (n > 0)
+        done += n;
+      if (n < (int) chunk)
+        break;
+    }
 
-  return return_code;
+  palloc_free_page (page);
+  return done;
+
+ fault:
+  palloc_free_page (page);
+  syscall_exit(EXIT_STATUS_1);
+  NOT_REACHED ();
+}
+
+/*----------- FILE SYSTEM -------------------*/
+
+static bool
+syscall_chdir(const char *file)
+{
+  return file != NULL && filesys_chdir (file);
+}
+
+static bool
+syscall_mkdir(const char *file)
+{
+  return file != NULL && filesys_create (file, 0, true);
 }
 
 static bool
 syscall_readdir(int fd, char *file)
 {
-  lock_acquire (&lock_file);
+  struct fd_entry *desc = fd_lookup (fd);
+  char name[NAME_MAX + 1];
 
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
   if (desc== NULL)
-  {
-    lock_release (&lock_file);
     return false;
-  }
 
   struct inode *inode = file_get_inode(desc->file);
   if(inode == NULL)
-  {
-    lock_release (&lock_file);
     return false;
-  }
 
   if(!inode_is_directory(inode))
-  {
-    lock_release (&lock_file);
     return false;
-  }
 
   ASSERT (desc->dir != NULL);
 
-  bool result = dir_readdir (desc->dir, file);
-  lock_release (&lock_file);
-  return result;
+  if (!dir_readdir (desc->dir, name))
+    return false;
+
+  if (!copy_to_user (file, name, strlen (name) + 1))
+    syscall_exit(EXIT_STATUS_1);
+  return true;
+}
+
+/* Reads as many entries of directory FD as fit in the SIZE
+   bytes at ENTS, up to a page's worth per call.  Returns the
+   number of entries read, 0 at the end of the directory, or -1
+   if FD is not an open directory. */
+static int
+syscall_getdents (int fd, struct dirent *ents, unsigned size)
+{
+  struct fd_entry *desc = fd_lookup (fd);
+  size_t max = size / sizeof *ents;
+  struct dirent *page;
+  size_t cnt;
+
+  if (desc == NULL || desc->dir == NULL)
+    return -1;
+  if (max == 0)
+    return 0;
+  if (max > PGSIZE / sizeof *ents)
+    max = PGSIZE / sizeof *ents;
+
+  page = palloc_get_page (0);
+  if (page == NULL)
+    return -1;
+
+  cnt = dir_readdir_batch (desc->dir, page, max);
+  if (!copy_to_user (ents, page, cnt * sizeof *ents))
+    {
+      palloc_free_page (page);
+      syscall_exit (EXIT_STATUS_1);
+    }
+  palloc_free_page (page);
+  return cnt;
 }
 
 static bool
 syscall_isdir(int fd)
 {
-  lock_acquire (&lock_file);
+  struct fd_entry *desc = fd_lookup (fd);
 
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
-  bool ret = inode_is_directory (file_get_inode(desc->file));
+  if (desc == NULL)
+    return false;
 
-  lock_release (&lock_file);
-  return ret;
+  return inode_is_directory (file_get_inode(desc->file));
 }
 
 static int
 syscall_inumber(int fd)
 {
-  lock_acquire (&lock_file);
+  struct fd_entry *desc = fd_lookup (fd);
+
+  if (desc == NULL)
+    return -1;
+
+  return (int) inode_get_inumber (file_get_inode(desc->file));
+}
+
+/*----------- MEMORY-MAPPED FILES -------------------*/
+
+/* Maps open file FD at ADDR.  Without VM there is no way to
+   fault pages in, so mapping always fails. */
+static int
+syscall_mmap (int fd UNUSED, void *addr UNUSED)
+{
+#ifdef VM
+  struct fd_entry *desc = fd_lookup (fd);
+
+  if (desc == NULL || desc->dir != NULL)
+    return -1;
+  return mmap_map (desc->file, addr);
+#else
+  return -1;
+#endif
+}
+
+static void
+syscall_munmap (int mapping UNUSED)
+{
+#ifdef VM
+  mmap_unmap (mapping);
+#endif
+}
+
+/*----------- POSITIONAL AND VECTORED I/O -------------------*/
+
+static int
+syscall_pread (int fd, void *buffer, unsigned length, unsigned offset)
+{
+  struct fd_entry *desc = fd_lookup (fd);
+
+  if (desc == NULL || (int) offset < 0)
+    return -1;
+
+  return file_xfer (desc->file, buffer, length, offset, false);
+}
 
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
-  int ret = (int) inode_get_inumber (file_get_inode(desc->file));
+static int
+syscall_pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  struct fd_entry *desc = fd_lookup (fd);
+
+  if (desc == NULL || (int) offset < 0)
+    return -1;
+
+  if (inode_is_directory (file_get_inode(desc->file)))
+    return -1;
+
+  return file_xfer (desc->file, (void *) buffer, size, offset, true);
+}
+
+/* Copies the IOVCNT-element user array IOV into newly allocated
+   kernel memory, which the caller must free.  Returns NULL if
+   IOVCNT is out of range or memory is short.  Exits the process
+   if IOV is not valid user memory. */
+static struct iovec *
+copy_in_iovec (const struct iovec *iov, int iovcnt)
+{
+  struct iovec *kiov;
+
+  if (iovcnt <= 0 || iovcnt > IOV_MAX)
+    return NULL;
+
+  kiov = malloc (iovcnt * sizeof *kiov);
+  if (kiov == NULL)
+    return NULL;
+  if (!copy_from_user (kiov, iov, iovcnt * sizeof *kiov))
+  {
+    free (kiov);
+    syscall_exit(EXIT_STATUS_1);
+  }
+  return kiov;
+}
+
+/* Reads into each of the IOVCNT buffers in IOV in turn, stopping
+   early at a short read.  Returns the total bytes read, or -1 if
+   nothing could be read. */
+static int
+syscall_readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct iovec *kiov;
+  int i, total = 0;
+
+  if (iovcnt == 0)
+    return 0;
+  kiov = copy_in_iovec (iov, iovcnt);
+  if (kiov == NULL)
+    return -1;
+
+  for (i = 0; i < iovcnt; i++)
+  {
+    int result = syscall_read (fd, kiov[i].iov_base, kiov[i].iov_len);
+    if (result < 0)
+    {
+      if (total == 0)
+        total = -1;
+      break;
+    }
+    total += result;
+    if ((unsigned) result < kiov[i].iov_len)
+      break;
+  }
 
-  lock_release (&lock_file);
-  return ret;
+  free (kiov);
+  return total;
+}
+
+/* Writes each of the IOVCNT buffers in IOV in turn, stopping
+   early at a short write.  Returns the total bytes written, or
+   -1 if nothing could be written. */
+static int
+syscall_writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct iovec *kiov;
+  int i, total = 0;
+
+  if (fd == 0)
+    return -1;
+  if (iovcnt == 0)
+    return 0;
+  kiov = copy_in_iovec (iov, iovcnt);
+  if (kiov == NULL)
+    return -1;
+
+  for (i = 0; i < iovcnt; i++)
+  {
+    int result = syscall_write (fd, kiov[i].iov_base, kiov[i].iov_len);
+    if (result < 0)
+    {
+      if (total == 0)
+        total = -1;
+      break;
+    }
+    total += result;
+    if ((unsigned) result < kiov[i].iov_len)
+      break;
+  }
+
+  free (kiov);
+  return total;
+}
+
+/*----------- STATISTICS -------------------*/
+
+/* Copies statistics of the given KIND into the SIZE-byte user
+   BUFFER.  For STATS_SYSCALLS, fills one struct syscall_stat per
+   system call number, as many as fit.  For STATS_VM, fills as
+   much of a struct vm_stat for the calling process as fits, if
+   the kernel has virtual memory.  Returns the number of bytes
+   copied, or -1 if KIND is unknown. */
+static int
+syscall_stats (int kind, void *buffer, unsigned size)
+{
+  struct syscall_stat copy[SYSCALL_CNT];
+  enum intr_level old_level;
+
+#ifdef VM
+  if (kind == STATS_VM)
+    {
+      struct vm_stat vm_copy = thread_current ()->vm_stat;
+
+      if (size > sizeof vm_copy)
+        size = sizeof vm_copy;
+      if (!copy_to_user (buffer, &vm_copy, size))
+        syscall_exit(EXIT_STATUS_1);
+      return size;
+    }
+#endif
+  if (kind != STATS_SYSCALLS)
+    return -1;
+
+  if (size > sizeof copy)
+    size = sizeof copy;
+  size -= size % sizeof *copy;
+
+  old_level = intr_disable ();
+  memcpy (copy, syscall_stats_table, size);
+  intr_set_level (old_level);
+
+  if (!copy_to_user (buffer, copy, size))
+    syscall_exit(EXIT_STATUS_1);
+  return size;
+}
+
+/*----------- SUBMISSION RING -------------------*/
+
+/* Allocates a zeroed page for the current process's submission
+   ring and maps it writable at user address ADDR, which must be
+   page-aligned and unmapped.  Returns ADDR, or NULL on failure
+   or if the process already has a ring.  The page is freed with
+   the rest of the address space by pagedir_destroy(), or under
+   VM by page_table_destroy(), since it has a supplemental page
+   table entry that keeps later mappings off its address. */
+static struct ring *
+syscall_ring_setup (void *addr)
+{
+  struct thread *curr = thread_current ();
+  struct ring *ring;
+
+  if (curr->ring != NULL || addr == NULL || pg_ofs (addr) != 0
+      || !is_user_vaddr (addr)
+      || pagedir_get_page (curr->pagedir, addr) != NULL)
+    return NULL;
+
+  ring = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (ring == NULL)
+    return NULL;
+#ifdef VM
+  if (!page_alloc_fixed (addr, ring))
+#else
+  if (!pagedir_set_page (curr->pagedir, addr, ring, true))
+#endif
+  {
+    palloc_free_page (ring);
+    return NULL;
+  }
+
+  curr->ring = ring;
+  return addr;
+}
+
+/* Runs one submission SQE, which has already been copied out of
+   the shared page, and returns its result. */
+static int
+ring_run (const struct ring_sqe *sqe)
+{
+  char *name;
+  int result;
+
+  switch (sqe->op)
+  {
+    case RING_NOP:
+      return 0;
+    case RING_OPEN:
+      name = copy_in_string (sqe->buf);
+      result = syscall_open (name);
+      palloc_free_page (name);
+      return result;
+    case RING_CLOSE:
+      syscall_close (sqe->fd);
+      return 0;
+    case RING_READ:
+      if (sqe->offset < 0)
+        return syscall_read (sqe->fd, sqe->buf, sqe->len);
+      return syscall_pread (sqe->fd, sqe->buf, sqe->len, sqe->offset);
+    case RING_WRITE:
+      if (sqe->fd == 0)
+        return -1;
+      if (sqe->offset < 0)
+        return syscall_write (sqe->fd, sqe->buf, sqe->len);
+      return syscall_pwrite (sqe->fd, sqe->buf, sqe->len, sqe->offset);
+    default:
+      return -1;
+  }
+}
+
+/* Runs up to TO_SUBMIT queued operations from the current
+   process's ring, in order, posting a completion for each.
+   Stops early if the submission queue empties or the completion
+   queue fills.  Returns the number of operations run, or -1 if
+   there is no ring or its counters are corrupt.
+
+   The ring is read and written through its kernel mapping, so
+   queue entries need no validation beyond the copy taken of
+   each one, which keeps the process from changing it while it
+   runs.  Buffers named by the entries are still user memory and
+   go through the usual checks. */
+static int
+syscall_ring_enter (unsigned to_submit)
+{
+  struct ring *ring = thread_current ()->ring;
+  unsigned sq_head, sq_tail, cq_tail;
+  unsigned done = 0;
+
+  if (ring == NULL)
+    return -1;
+
+  sq_head = ring->sq_head;
+  sq_tail = ring->sq_tail;
+  cq_tail = ring->cq_tail;
+  if (sq_tail - sq_head > RING_ENTRIES
+      || cq_tail - ring->cq_head > RING_ENTRIES)
+    return -1;
+
+  while (done < to_submit && sq_head != sq_tail
+         && cq_tail - ring->cq_head < RING_ENTRIES)
+  {
+    struct ring_sqe sqe = ring->sq[sq_head % RING_ENTRIES];
+    struct ring_cqe *cqe = &ring->cq[cq_tail % RING_ENTRIES];
+
+    cqe->result = ring_run (&sqe);
+    cqe->user_data = sqe.user_data;
+
+    ring->sq_head = ++sq_head;
+    ring->cq_tail = ++cq_tail;
+    done++;
+  }
+  return done;
 }
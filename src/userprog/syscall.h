@@ -1,7 +1,14 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdbool.h>
+
+struct thread;
+
 void syscall_init (void);
 void syscall_exit (int status);
+void syscall_print_stats (void);
+void fd_inherit_pipes (struct thread *parent);
+bool fd_fork (struct thread *parent);
 
 #endif /* userprog/syscall.h */
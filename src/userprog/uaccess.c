@@ -0,0 +1,148 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Copying between kernel and user memory.
+
+   User addresses are never trusted.  Before the first byte of
+   each user page is touched, get_user() or put_user() probes it;
+   if the page is unmapped or read-only, the kernel page fault
+   handler resumes the probe at its recovery label with -1 in
+   EAX instead of panicking.  Once the probe succeeds the rest of
+   the page is copied with word-sized moves, so validation costs
+   one probe per page rather than one lookup per byte. */
+
+static inline int get_user (const uint8_t *uaddr);
+static inline bool put_user (uint8_t *udst, uint8_t byte);
+static bool is_user_range (const void *uaddr, size_t size);
+static void copy_words (void *dst, const void *src, size_t size);
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if any byte of the
+   source is not readable user memory. */
+bool
+copy_from_user (void *dst_, const void *usrc_, size_t size)
+{
+  uint8_t *dst = dst_;
+  const uint8_t *usrc = usrc_;
+
+  if (!is_user_range (usrc, size))
+    return false;
+
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (usrc);
+      if (chunk > size)
+        chunk = size;
+
+      if (get_user (usrc) == -1)
+        return false;
+      copy_words (dst, usrc, chunk);
+
+      dst += chunk;
+      usrc += chunk;
+      size -= chunk;
+    }
+  return true;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if any byte of the
+   destination is not writable user memory. */
+bool
+copy_to_user (void *udst_, const void *src_, size_t size)
+{
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+
+  if (!is_user_range (udst, size))
+    return false;
+
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (udst);
+      if (chunk > size)
+        chunk = size;
+
+      if (!put_user (udst, *src))
+        return false;
+      copy_words (udst + 1, src + 1, chunk - 1);
+
+      udst += chunk;
+      src += chunk;
+      size -= chunk;
+    }
+  return true;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes including the null
+   terminator.  Returns the length of the string, or SIZE if it
+   does not fit (in which case DST is not null-terminated), or -1
+   if the string runs into memory that is not readable user
+   memory. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  size_t len = 0;
+
+  while (len < size)
+    {
+      const char *page_end = (const char *) pg_round_down (usrc) + PGSIZE;
+
+      if (!is_user_vaddr (usrc) || get_user ((const uint8_t *) usrc) == -1)
+        return -1;
+      for (; usrc < page_end && len < size; usrc++, len++)
+        if ((dst[len] = *usrc) == '\0')
+          return len;
+    }
+  return size;
+}
+
+/* Reads a byte at user virtual address UADDR.
+   UADDR must be below PHYS_BASE.
+   Returns the byte value if successful, -1 if a segfault
+   occurred. */
+static inline int
+get_user (const uint8_t *uaddr)
+{
+  int result;
+  asm ("movl $1f, %0; movzbl %1, %0; 1:"
+       : "=&a" (result) : "m" (*uaddr));
+  return result;
+}
+
+/* Writes BYTE to user address UDST.
+   UDST must be below PHYS_BASE.
+   Returns true if successful, false if a segfault occurred. */
+static inline bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+  int error_code;
+  asm ("movl $1f, %0; movb %b2, %1; 1:"
+       : "=&a" (error_code), "=m" (*udst) : "q" (byte));
+  return error_code != -1;
+}
+
+/* Returns true if the SIZE bytes starting at UADDR all lie below
+   PHYS_BASE. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  return start + size >= start && start + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST a word at a time, then the
+   remaining bytes.  The buffers must not overlap. */
+static void
+copy_words (void *dst, const void *src, size_t size)
+{
+  size_t words = size / sizeof (uint32_t);
+  size_t bytes = size % sizeof (uint32_t);
+
+  asm volatile ("rep movsl"
+                : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (bytes) : : "memory");
+}
@@ -0,0 +1,306 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "vm/page.h"
+
+/* Frame table.
+
+   Every user pool frame that holds process pages is on
+   frame_list, which the clock hand sweeps when the user pool is
+   exhausted.  A frame any of whose pages was accessed since the
+   hand last passed gets a second chance; the first one that was
+   not is evicted through page_frame_evict().
+
+   Each frame has a lock, held by an owner while it loads, shares
+   or frees the frame and by the evicting thread while it writes
+   the frame out, so a page is never loaded and evicted at the
+   same time.  The scan takes frame locks only with
+   lock_try_acquire(), so it never waits on one while holding
+   scan_lock, and skips frames the evicting thread already holds,
+   as page_copy_on_write() does with the shared frame it copies.
+
+   A thread blocking in frame_lock() may find the frame evicted,
+   handed to another page and freed by that page's owner by the
+   time it gets the lock.  It therefore counts itself in the
+   frame's WAITER_CNT under scan_lock before blocking, and
+   frame_free() leaves a frame with waiters for the last of them
+   to free.
+
+   Frames holding read-only pages of executables are also in
+   text_table, keyed by inode and offset, so that the next
+   process to fault the same page maps the frame instead of
+   reading it again.  A frame leaves the table when it is
+   evicted or freed.  Those paths take text_lock with the frame
+   locked, so lookups take frame locks only with
+   lock_try_acquire() and treat a busy frame as a miss. */
+
+static struct list frame_list;          /* All frames in use. */
+static struct list_elem *hand;          /* Clock hand, or null. */
+static size_t frame_cnt;                /* Number of frames in list. */
+static struct lock scan_lock;           /* Protects the above. */
+
+static struct hash text_table;          /* Shareable text frames. */
+static struct lock text_lock;           /* Protects text_table. */
+
+static struct frame *evict (void);
+static struct frame *advance_hand (void);
+static void remove_text (struct frame *);
+static hash_hash_func text_hash;
+static hash_less_func text_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void) 
+{
+  list_init (&frame_list);
+  hand = NULL;
+  frame_cnt = 0;
+  lock_init (&scan_lock);
+  hash_init (&text_table, text_hash, text_less, NULL);
+  lock_init (&text_lock);
+}
+
+/* Returns a locked frame with no pages, evicting other pages if
+   the user pool is empty.  Returns a null pointer if no frame
+   can be freed. */
+struct frame *
+frame_alloc_and_lock (void) 
+{
+  struct frame *f;
+  void *base;
+
+  base = palloc_get_page (PAL_USER);
+  if (base == NULL)
+    return evict ();
+
+  f = malloc (sizeof *f);
+  if (f == NULL)
+    {
+      palloc_free_page (base);
+      return NULL;
+    }
+  lock_init (&f->lock);
+  lock_acquire (&f->lock);
+  f->base = base;
+  list_init (&f->pages);
+  f->dirty = false;
+  f->inode = NULL;
+  f->waiter_cnt = 0;
+  f->freed = false;
+
+  lock_acquire (&scan_lock);
+  list_push_back (&frame_list, &f->elem);
+  frame_cnt++;
+  lock_release (&scan_lock);
+  return f;
+}
+
+/* Locks P's frame, if it has one, so that it cannot be evicted
+   or shared.  Afterward P->frame is either null or locked by the
+   caller. */
+void
+frame_lock (struct page *p) 
+{
+  struct frame *f;
+  bool free_it;
+
+  lock_acquire (&scan_lock);
+  f = p->frame;
+  if (f == NULL)
+    {
+      lock_release (&scan_lock);
+      return;
+    }
+  f->waiter_cnt++;
+  lock_release (&scan_lock);
+
+  lock_acquire (&f->lock);
+
+  /* frame_free() needs the lock we hold, so FREED is settled. */
+  lock_acquire (&scan_lock);
+  free_it = --f->waiter_cnt == 0 && f->freed;
+  lock_release (&scan_lock);
+
+  if (f != p->frame)
+    {
+      /* Evicted while we waited, and maybe freed too. */
+      lock_release (&f->lock);
+      ASSERT (p->frame == NULL);
+      if (free_it)
+        free (f);
+    }
+}
+
+/* Releases frame F, locked by frame_alloc_and_lock() or
+   frame_lock(). */
+void
+frame_unlock (struct frame *f) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  lock_release (&f->lock);
+}
+
+/* Returns locked frame F, which no page maps, to the user
+   pool. */
+void
+frame_free (struct frame *f) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (list_empty (&f->pages));
+
+  remove_text (f);
+  lock_acquire (&scan_lock);
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+  frame_cnt--;
+  f->freed = f->waiter_cnt > 0;
+  lock_release (&scan_lock);
+
+  lock_release (&f->lock);
+  palloc_free_page (f->base);
+  if (!f->freed)
+    free (f);
+}
+
+/* Runs the clock algorithm to find a frame, writes out the
+   pages in it, and returns the frame locked.  Returns a null
+   pointer if every frame stays busy or recently used for two
+   full sweeps, or if the victim cannot be written out. */
+static struct frame *
+evict (void) 
+{
+  size_t i;
+
+  lock_acquire (&scan_lock);
+  for (i = 0; i < frame_cnt * 2; i++) 
+    {
+      struct frame *f = advance_hand ();
+
+      if (lock_held_by_current_thread (&f->lock)
+          || !lock_try_acquire (&f->lock))
+        continue;
+      if (page_frame_accessed (f))
+        {
+          lock_release (&f->lock);
+          continue;
+        }
+      lock_release (&scan_lock);
+
+      if (!page_frame_evict (f))
+        {
+          lock_release (&f->lock);
+          return NULL;
+        }
+      remove_text (f);
+      return f;
+    }
+  lock_release (&scan_lock);
+  return NULL;
+}
+
+/* Moves the clock hand to the next frame, wrapping around, and
+   returns that frame.  scan_lock must be held and frame_list
+   must not be empty. */
+static struct frame *
+advance_hand (void) 
+{
+  ASSERT (lock_held_by_current_thread (&scan_lock));
+  ASSERT (!list_empty (&frame_list));
+
+  if (hand == NULL || hand == list_end (&frame_list))
+    hand = list_begin (&frame_list);
+  else
+    {
+      hand = list_next (hand);
+      if (hand == list_end (&frame_list))
+        hand = list_begin (&frame_list);
+    }
+  return list_entry (hand, struct frame, elem);
+}
+
+/* Returns the frame in the text table holding BYTES bytes of
+   INODE from offset OFS, followed by zeros, locked.  Returns a
+   null pointer if there is none or it is busy loading or being
+   evicted. */
+struct frame *
+frame_lookup_text (struct inode *inode, off_t ofs, size_t bytes) 
+{
+  struct frame key, *f = NULL;
+  struct hash_elem *e;
+
+  key.inode = inode;
+  key.text_ofs = ofs;
+  key.text_bytes = bytes;
+
+  lock_acquire (&text_lock);
+  e = hash_find (&text_table, &key.hash_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, hash_elem);
+      if (!lock_try_acquire (&f->lock))
+        f = NULL;
+    }
+  lock_release (&text_lock);
+  return f;
+}
+
+/* Adds locked frame F, which will hold BYTES bytes of INODE from
+   offset OFS followed by zeros and must never be written, to the
+   text table.  If another frame already holds that page, F stays
+   private. */
+void
+frame_add_text (struct frame *f, struct inode *inode, off_t ofs,
+                size_t bytes) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (f->inode == NULL);
+
+  f->inode = inode;
+  f->text_ofs = ofs;
+  f->text_bytes = bytes;
+  lock_acquire (&text_lock);
+  if (hash_insert (&text_table, &f->hash_elem) != NULL)
+    f->inode = NULL;
+  lock_release (&text_lock);
+}
+
+/* Removes locked frame F from the text table, if it is there. */
+static void
+remove_text (struct frame *f) 
+{
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  if (f->inode != NULL)
+    {
+      lock_acquire (&text_lock);
+      hash_delete (&text_table, &f->hash_elem);
+      lock_release (&text_lock);
+      f->inode = NULL;
+    }
+}
+
+/* Returns a hash value for the text frame that E refers to. */
+static unsigned
+text_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct frame *f = hash_entry (e, struct frame, hash_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->text_ofs);
+}
+
+/* Returns true if text frame A precedes text frame B. */
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED) 
+{
+  const struct frame *a = hash_entry (a_, struct frame, hash_elem);
+  const struct frame *b = hash_entry (b_, struct frame, hash_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  else if (a->text_ofs != b->text_ofs)
+    return a->text_ofs < b->text_ofs;
+  else
+    return a->text_bytes < b->text_bytes;
+}
@@ -0,0 +1,46 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct inode;
+struct page;
+
+/* A user pool frame holding process pages.  Usually one page
+   maps a frame; after fork() several processes' pages may share
+   it copy-on-write, and every process running one program maps
+   the same frame for each page of its read-only text. */
+struct frame
+  {
+    struct lock lock;           /* Held while loading, sharing or evicting. */
+    void *base;                 /* Kernel virtual base address. */
+    struct list pages;          /* Pages mapping the frame. */
+    bool dirty;                 /* Modified, even if no PTE says so. */
+    struct list_elem elem;      /* Element in frame list. */
+    int waiter_cnt;             /* Threads in frame_lock() for it. */
+    bool freed;                 /* Freed while WAITER_CNT > 0? */
+
+    /* Set while the frame is in the text table, holding
+       TEXT_BYTES bytes of INODE from TEXT_OFS, then zeros. */
+    struct inode *inode;        /* Executable, or null. */
+    off_t text_ofs;             /* Offset in INODE. */
+    size_t text_bytes;          /* Bytes read from INODE. */
+    struct hash_elem hash_elem; /* Element in text table. */
+  };
+
+void frame_init (void);
+
+struct frame *frame_alloc_and_lock (void);
+void frame_lock (struct page *);
+void frame_unlock (struct frame *);
+void frame_free (struct frame *);
+
+struct frame *frame_lookup_text (struct inode *, off_t ofs, size_t bytes);
+void frame_add_text (struct frame *, struct inode *, off_t ofs,
+                     size_t bytes);
+
+#endif /* vm/frame.h */
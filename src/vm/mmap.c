@@ -0,0 +1,153 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   Mapping a file only adds its pages to the supplemental page
+   table; each is read from the file the first time it is
+   touched, like an executable's pages.  Unlike those, a dirty
+   mapped page is written back to the file with file_write_at()
+   instead of going to swap, whether it is evicted, unmapped or
+   dropped at process exit. */
+
+/* A mapping of a file into the current process. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's mappings. */
+    int id;                     /* Mapping identifier. */
+    struct file *file;          /* Private handle on the file. */
+    uint8_t *base;              /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+  };
+
+static struct mapping *find_mapping (int id);
+static void unmap (struct mapping *);
+
+/* Maps FILE into the current process at page-aligned address
+   ADDR.  Returns the new mapping's identifier, or -1 if FILE is
+   empty or any page it would cover is already in use. */
+int
+mmap_map (struct file *file, void *addr) 
+{
+  struct thread *t = thread_current ();
+  uint8_t *base = addr;
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  length = file_length (file);
+  if (base == NULL || pg_ofs (base) != 0 || length <= 0)
+    return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+  m->base = base;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  if ((uintptr_t) base + m->page_cnt * PGSIZE > (uintptr_t) PHYS_BASE
+      || (uintptr_t) base + m->page_cnt * PGSIZE < (uintptr_t) base)
+    {
+      free (m);
+      return -1;
+    }
+  for (i = 0; i < m->page_cnt; i++)
+    if (pagedir_get_page (t->pagedir, base + i * PGSIZE) != NULL)
+      {
+        free (m);
+        return -1;
+      }
+
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return -1;
+    }
+  for (i = 0; i < m->page_cnt; i++) 
+    {
+      off_t ofs = i * PGSIZE;
+      struct page *p = page_alloc (base + ofs, true);
+
+      if (p == NULL)
+        {
+          /* Overlaps another page, or out of memory. */
+          m->page_cnt = i;
+          unmap (m);
+          return -1;
+        }
+      p->file = m->file;
+      p->file_ofs = ofs;
+      p->file_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+      p->write_back = true;
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Unmaps mapping ID of the current process, writing dirty pages
+   back to the file.  Returns true if successful, false if there
+   is no such mapping. */
+bool
+mmap_unmap (int id) 
+{
+  struct mapping *m = find_mapping (id);
+
+  if (m == NULL)
+    return false;
+  list_remove (&m->elem);
+  unmap (m);
+  return true;
+}
+
+/* Unmaps every mapping of the current process.  Called when the
+   process exits, before its page table is destroyed. */
+void
+mmap_exit (void) 
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_pop_front (&t->mappings),
+                       struct mapping, elem));
+}
+
+/* Returns the current process's mapping with identifier ID, or
+   a null pointer if there is none. */
+static struct mapping *
+find_mapping (int id) 
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        return m;
+    }
+  return NULL;
+}
+
+/* Frees M's pages, writing back dirty ones, closes its file and
+   frees M.  M must not be in any list. */
+static void
+unmap (struct mapping *m) 
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_free (m->base + i * PGSIZE);
+  file_close (m->file);
+  free (m);
+}
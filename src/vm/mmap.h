@@ -0,0 +1,12 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <stdbool.h>
+
+struct file;
+
+int mmap_map (struct file *, void *addr);
+bool mmap_unmap (int id);
+void mmap_exit (void);
+
+#endif /* vm/mmap.h */
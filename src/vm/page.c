@@ -0,0 +1,660 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   load() no longer reads a program into memory before it
+   starts.  Instead it records, for each page of each segment,
+   where the page's contents come from, and page_fault() calls
+   page_in() to read a page the first time the process (or the
+   kernel, on the process's behalf) touches it.  Pages that are
+   never touched are never read.  A read-only page of the
+   executable is looked up in the frame table's text table
+   first, so every process running the same program maps one
+   frame for it, read from disk once.
+
+   When memory runs short, the frame table evicts pages through
+   page_frame_evict().  A page that is still identical to its
+   file or zero-fill contents is simply dropped and read again
+   later.
+   A dirty page of a memory-mapped file is written back to the
+   file; any other dirty page goes to swap.
+
+   A page that starts out all zeros and is first read, not
+   written, is mapped read-only to a single shared zero page
+   instead of a frame of its own, so that large arrays in BSS
+   cost nothing until they are written.  Writing one then takes
+   the copy-on-write path, which gives it a private frame.
+
+   fork() shares resident pages between parent and child through
+   read-only mappings of the same frame, and page_copy_on_write()
+   gives a process its own copy when it first writes one.
+
+   The stack starts out as a single page and grows downward on
+   demand: a fault just below the stack pointer adds a zeroed
+   page, up to stack_page_limit pages below PHYS_BASE.
+
+   Each process counts its faults, evictions, swap traffic and
+   resident pages in its struct vm_stat.  An evicting thread
+   updates its victims' counters without locking them, so the
+   counts are only approximate. */
+
+/* Maximum stack size in pages.  Set by the -sl kernel
+   command-line option. */
+size_t stack_page_limit = STACK_PAGES_DEFAULT;
+
+/* Print each process's paging statistics when it exits?  Set by
+   the -vs kernel command-line option. */
+bool page_print_stats;
+
+/* The furthest below the stack pointer an instruction may
+   legitimately touch the stack: PUSHA writes 32 bytes below
+   %esp before adjusting it. */
+#define STACK_SLOP 32
+
+/* A page of zeros, mapped read-only by every untouched zero-fill
+   page that has been read.  Never in the frame table, and mapped
+   as a shared page so that pagedir_destroy() leaves it alone. */
+static void *zero_page;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static void page_release (struct page *);
+static void add_resident (struct thread *, int delta);
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void) 
+{
+  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
+/* Creates an empty supplemental page table for the current
+   process.  Returns true if successful, false if memory is
+   short. */
+bool
+page_table_create (void) 
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->pages == NULL);
+
+  t->pages = malloc (sizeof *t->pages);
+  if (t->pages == NULL)
+    return false;
+  if (!hash_init (t->pages, page_hash, page_less, NULL))
+    {
+      free (t->pages);
+      t->pages = NULL;
+      return false;
+    }
+  return true;
+}
+
+/* Destroys the current process's supplemental page table,
+   unmapping and freeing every resident page.  Must be called
+   before the page directory is destroyed. */
+void
+page_table_destroy (void) 
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages == NULL)
+    return;
+  hash_destroy (t->pages, page_destroy);
+  free (t->pages);
+  t->pages = NULL;
+}
+
+/* Adds a page at user virtual address ADDR to the current
+   process's supplemental page table, initially all zeros and
+   not resident.  Returns the new page, or a null pointer if
+   ADDR already has a page or memory is short. */
+struct page *
+page_alloc (void *addr, bool writable) 
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (addr) == 0);
+  ASSERT (is_user_vaddr (addr));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->addr = addr;
+  p->writable = writable;
+  p->thread = t;
+  p->frame = NULL;
+  p->sector = SWAP_NONE;
+  p->zero_mapped = false;
+  p->kpage = NULL;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->file_bytes = 0;
+  p->write_back = false;
+
+  if (hash_insert (t->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds a page at user virtual address ADDR to the current
+   process's supplemental page table, backed for good by KPAGE, a
+   user pool page that the frame table does not manage, and maps
+   it writable.  Such a page is never evicted or inherited by
+   fork(), and KPAGE is freed along with it.  Returns true if
+   successful, false if ADDR already has a page or memory is
+   short, in which case the caller still owns KPAGE. */
+bool
+page_alloc_fixed (void *addr, void *kpage) 
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_alloc (addr, true);
+
+  if (p == NULL)
+    return false;
+  if (!pagedir_set_page (t->pagedir, addr, kpage, true))
+    {
+      hash_delete (t->pages, &p->hash_elem);
+      free (p);
+      return false;
+    }
+  p->kpage = kpage;
+  return true;
+}
+
+/* Removes the current process's page at ADDR, writing it back
+   to its file if it is a dirty memory-mapped page, and frees
+   it. */
+void
+page_free (void *addr) 
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (addr);
+
+  ASSERT (p != NULL);
+
+  hash_delete (t->pages, &p->hash_elem);
+  page_release (p);
+}
+
+/* Returns the current process's page containing user virtual
+   address ADDR, or a null pointer if there is none. */
+struct page *
+page_lookup (const void *addr) 
+{
+  struct thread *t = thread_current ();
+  struct page p;
+  struct hash_elem *e;
+
+  if (t->pages == NULL)
+    return NULL;
+
+  p.addr = pg_round_down (addr);
+  e = hash_find (t->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Makes the page containing FAULT_ADDR resident, reading its
+   contents from swap or from its file.  WRITE says whether the
+   access that faulted was a write; a read of a page that is
+   still all zeros maps the shared zero page.  Returns true if
+   successful, false if FAULT_ADDR has no page or no frame can be
+   found for it. */
+bool
+page_in (void *fault_addr, bool write) 
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (fault_addr);
+  struct frame *f;
+  bool from_swap = false;
+
+  if (p == NULL)
+    return false;
+  /* A fixed page is mapped for as long as it exists. */
+  if (p->kpage != NULL)
+    return true;
+
+  /* Wait out an eviction in progress.  If it failed, the page is
+     still resident and mapped. */
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      frame_unlock (p->frame);
+      return true;
+    }
+
+  if (!write && p->file == NULL && p->sector == SWAP_NONE)
+    {
+      p->zero_mapped = pagedir_set_shared_page (t->pagedir, p->addr,
+                                                zero_page, false);
+      if (p->zero_mapped)
+        t->vm_stat.minor_faults++;
+      return p->zero_mapped;
+    }
+
+  /* Read-only file pages are never dirty, so any frame holding
+     the same bytes of the same file can back this one. */
+  if (p->file != NULL && !p->writable && !p->write_back)
+    {
+      struct inode *inode = file_get_inode (p->file);
+
+      f = frame_lookup_text (inode, p->file_ofs, p->file_bytes);
+      if (f != NULL)
+        {
+          if (!pagedir_set_page (t->pagedir, p->addr, f->base, false))
+            {
+              frame_unlock (f);
+              return false;
+            }
+          list_push_back (&f->pages, &p->frame_elem);
+          p->frame = f;
+          frame_unlock (f);
+          t->vm_stat.minor_faults++;
+          add_resident (t, 1);
+          return true;
+        }
+      f = frame_alloc_and_lock ();
+      if (f == NULL)
+        return false;
+      frame_add_text (f, inode, p->file_ofs, p->file_bytes);
+    }
+  else
+    {
+      f = frame_alloc_and_lock ();
+      if (f == NULL)
+        return false;
+    }
+
+  if (p->sector != SWAP_NONE)
+    {
+      swap_read (p->sector, f->base);
+      p->sector = SWAP_NONE;
+      from_swap = true;
+    }
+  else
+    {
+      uint8_t *kpage = f->base;
+
+      if (p->file != NULL
+          && file_read_at (p->file, kpage, p->file_bytes, p->file_ofs)
+             != (off_t) p->file_bytes)
+        {
+          frame_free (f);
+          return false;
+        }
+      memset (kpage + p->file_bytes, 0, PGSIZE - p->file_bytes);
+    }
+
+  if (!pagedir_set_page (t->pagedir, p->addr, f->base, p->writable))
+    {
+      frame_free (f);
+      return false;
+    }
+
+  /* Contents that came back from swap no longer match the
+     page's file or zero fill, so they must go back to swap if
+     the frame is evicted again, even if it is not written. */
+  f->dirty = from_swap;
+  list_push_back (&f->pages, &p->frame_elem);
+  p->frame = f;
+  frame_unlock (f);
+
+  if (from_swap)
+    t->vm_stat.swap_in_bytes += PGSIZE;
+  if (from_swap || p->file != NULL)
+    t->vm_stat.major_faults++;
+  else
+    t->vm_stat.minor_faults++;
+  add_resident (t, 1);
+  return true;
+}
+
+/* Grows the stack to cover FAULT_ADDR, given the process's user
+   stack pointer ESP, and makes the new page resident.  Returns
+   true if successful, false if FAULT_ADDR does not look like a
+   stack access, lies beyond the stack limit, or memory is
+   short. */
+bool
+page_grow_stack (void *fault_addr, const void *esp) 
+{
+  uint8_t *addr = fault_addr;
+  size_t limit = stack_page_limit * PGSIZE;
+
+  if (esp == NULL || addr < (const uint8_t *) esp - STACK_SLOP
+      || (uintptr_t) PHYS_BASE - (uintptr_t) pg_round_down (addr) > limit
+      || page_lookup (addr) != NULL)
+    return false;
+  if (page_alloc (pg_round_down (addr), true) == NULL)
+    return false;
+  return page_in (addr, true);
+}
+
+/* Gives the current process a private, writable copy of the
+   copy-on-write page containing FAULT_ADDR, which it tried to
+   write.  Returns true if successful, false if FAULT_ADDR is not
+   in a writable page or memory is short. */
+bool
+page_copy_on_write (void *fault_addr) 
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (fault_addr);
+  struct frame *f, *copy;
+
+  if (p == NULL || !p->writable)
+    return false;
+
+  if (p->zero_mapped)
+    {
+      pagedir_clear_page (t->pagedir, p->addr);
+      p->zero_mapped = false;
+      return page_in (p->addr, true);
+    }
+
+  frame_lock (p);
+  f = p->frame;
+  if (f == NULL)
+    {
+      /* Evicted meanwhile.  The retried write will fault the
+         page back in as a private copy. */
+      return true;
+    }
+
+  if (pagedir_is_dirty (t->pagedir, p->addr))
+    f->dirty = true;
+  t->vm_stat.minor_faults++;
+  if (list_size (&f->pages) == 1)
+    {
+      /* Every other sharer is gone. */
+      pagedir_set_writable (t->pagedir, p->addr, true);
+      frame_unlock (f);
+      return true;
+    }
+
+  copy = frame_alloc_and_lock ();
+  if (copy == NULL)
+    {
+      frame_unlock (f);
+      return false;
+    }
+  memcpy (copy->base, f->base, PGSIZE);
+  copy->dirty = f->dirty;
+  pagedir_clear_page (t->pagedir, p->addr);
+  list_remove (&p->frame_elem);
+  frame_unlock (f);
+
+  pagedir_set_page (t->pagedir, p->addr, copy->base, true);
+  list_push_back (&copy->pages, &p->frame_elem);
+  p->frame = copy;
+  frame_unlock (copy);
+  return true;
+}
+
+/* Copies PARENT's supplemental page table into the current
+   process, which PARENT has just created with fork().  Resident
+   pages are not copied: both processes map the same frame
+   read-only until one of them writes it.  Swapped-out pages share
+   their swap slot, and pages not yet read share their origin,
+   with EXECUTABLE (the child's handle on the program) standing
+   in for the parent's.  Memory-mapped files are not inherited.
+   PARENT must be blocked in fork().  Returns true if successful,
+   false if memory is short. */
+bool
+page_table_copy (struct thread *parent, struct file *executable) 
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  hash_first (&i, parent->pages);
+  while (hash_next (&i)) 
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *p;
+      struct frame *f;
+
+      if (pp->write_back || pp->kpage != NULL)
+        continue;
+
+      p = page_alloc (pp->addr, pp->writable);
+      if (p == NULL)
+        return false;
+      if (pp->file != NULL)
+        {
+          ASSERT (pp->file == parent->executable);
+          p->file = executable;
+          p->file_ofs = pp->file_ofs;
+          p->file_bytes = pp->file_bytes;
+        }
+
+      frame_lock (pp);
+      f = pp->frame;
+      if (f != NULL)
+        {
+          if (pagedir_is_dirty (parent->pagedir, pp->addr))
+            f->dirty = true;
+          if (!pagedir_set_page (t->pagedir, p->addr, f->base, false))
+            {
+              frame_unlock (f);
+              return false;
+            }
+          pagedir_set_writable (parent->pagedir, pp->addr, false);
+          list_push_back (&f->pages, &p->frame_elem);
+          p->frame = f;
+          frame_unlock (f);
+          add_resident (t, 1);
+        }
+      else if (pp->sector != SWAP_NONE)
+        {
+          swap_dup (pp->sector);
+          p->sector = pp->sector;
+        }
+    }
+  return true;
+}
+
+/* Returns true if any page mapping locked frame F was accessed
+   since the last call, and clears their accessed bits. */
+bool
+page_frame_accessed (struct frame *f) 
+{
+  bool accessed = false;
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->thread->pagedir;
+
+      if (pagedir_is_accessed (pd, p->addr))
+        {
+          pagedir_set_accessed (pd, p->addr, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Writes the pages mapping locked frame F out of memory so that
+   F can be reused.  Unmaps them first, so that an owner that
+   touches one meanwhile faults and waits on F's lock.  Returns
+   true if successful, leaving F with no pages, or false if swap
+   is full, in which case every page stays resident and
+   mapped. */
+bool
+page_frame_evict (struct frame *f) 
+{
+  disk_sector_t sector = SWAP_NONE;
+  bool dirty = f->dirty;
+  struct page *first;
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+  ASSERT (!list_empty (&f->pages));
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->thread->pagedir;
+
+      pagedir_clear_page (pd, p->addr);
+      if (pagedir_is_dirty (pd, p->addr))
+        dirty = true;
+    }
+
+  /* A clean frame still matches its file or zero fill.  A dirty
+     one goes back to its file if memory-mapped (such pages are
+     never shared), otherwise to swap. */
+  first = list_entry (list_front (&f->pages), struct page, frame_elem);
+  if (dirty && first->write_back)
+    file_write_at (first->file, f->base, first->file_bytes,
+                   first->file_ofs);
+  else if (dirty)
+    {
+      sector = swap_write (f->base);
+      if (sector == SWAP_NONE)
+        {
+          bool shared = list_size (&f->pages) > 1;
+
+          /* The page tables already exist, so this cannot fail. */
+          for (e = list_begin (&f->pages); e != list_end (&f->pages);
+               e = list_next (e))
+            {
+              struct page *p = list_entry (e, struct page, frame_elem);
+              pagedir_set_page (p->thread->pagedir, p->addr, f->base,
+                                p->writable && !shared);
+            }
+          f->dirty = true;
+          return false;
+        }
+    }
+
+  if (sector != SWAP_NONE)
+    first->thread->vm_stat.swap_out_bytes += PGSIZE;
+  while (!list_empty (&f->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem);
+      p->thread->vm_stat.evictions++;
+      add_resident (p->thread, -1);
+      p->frame = NULL;
+      p->sector = sector;
+      if (sector != SWAP_NONE && !list_empty (&f->pages))
+        swap_dup (sector);
+    }
+  f->dirty = false;
+  return true;
+}
+
+/* Frees page P and its swap slot, writing P back to its file
+   first if it is a dirty memory-mapped page.
+   A hash_action_func for page_table_destroy(). */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED) 
+{
+  page_release (hash_entry (e, struct page, hash_elem));
+}
+
+/* Unmaps and frees page P, which is no longer in any page
+   table, along with its swap slot and, unless another process
+   still shares it, its frame. */
+static void
+page_release (struct page *p) 
+{
+  uint32_t *pd = p->thread->pagedir;
+
+  if (p->kpage != NULL)
+    {
+      pagedir_clear_page (pd, p->addr);
+      palloc_free_page (p->kpage);
+      free (p);
+      return;
+    }
+  if (p->zero_mapped)
+    pagedir_clear_page (pd, p->addr);
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      struct frame *f = p->frame;
+
+      pagedir_clear_page (pd, p->addr);
+      if (pagedir_is_dirty (pd, p->addr))
+        {
+          if (p->write_back)
+            file_write_at (p->file, f->base, p->file_bytes, p->file_ofs);
+          else
+            f->dirty = true;
+        }
+      list_remove (&p->frame_elem);
+      add_resident (p->thread, -1);
+      if (list_empty (&f->pages))
+        frame_free (f);
+      else
+        frame_unlock (f);
+    }
+  else if (p->sector != SWAP_NONE)
+    swap_discard (p->sector);
+  free (p);
+}
+
+/* Prints the current process's paging statistics. */
+void
+page_report_stats (void) 
+{
+  struct thread *t = thread_current ();
+  const struct vm_stat *s = &t->vm_stat;
+
+  printf ("%s: %u major faults, %u minor faults, %u evictions, "
+          "%llu bytes swapped in, %llu bytes swapped out, "
+          "%u peak resident pages\n",
+          t->name, s->major_faults, s->minor_faults, s->evictions,
+          s->swap_in_bytes, s->swap_out_bytes, s->peak_resident_pages);
+}
+
+/* Adds DELTA to T's count of resident pages. */
+static void
+add_resident (struct thread *t, int delta) 
+{
+  struct vm_stat *s = &t->vm_stat;
+
+  s->resident_pages += delta;
+  if (s->resident_pages > s->peak_resident_pages)
+    s->peak_resident_pages = s->resident_pages;
+}
+
+/* Returns a hash value for the page that E refers to. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->addr, sizeof p->addr);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED) 
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+
+  return a->addr < b->addr;
+}
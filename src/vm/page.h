@@ -0,0 +1,67 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+#include "filesys/off_t.h"
+
+struct frame;
+struct thread;
+
+/* A virtual page in a process's supplemental page table.
+
+   Every page of a process's address space that is not a shared
+   memory segment or submission ring has one of these, whether
+   or not it is currently resident. */
+struct page
+  {
+    struct hash_elem hash_elem; /* Element in thread's `pages'. */
+    void *addr;                 /* User virtual address. */
+    bool writable;              /* Writable by the process? */
+    struct thread *thread;      /* Owning process. */
+
+    /* Set by the owner and cleared by an evicting thread, both
+       with the frame's lock held. */
+    struct frame *frame;        /* Frame, or null if not resident. */
+    struct list_elem frame_elem; /* Element in frame's `pages'. */
+    disk_sector_t sector;       /* Swap slot, or SWAP_NONE. */
+    bool zero_mapped;           /* Mapped read-only to the zero page? */
+    void *kpage;                /* Fixed page outside frame table, or null. */
+
+    /* Initial contents: FILE_BYTES bytes read from FILE at
+       FILE_OFS, followed by zeros.  A null FILE means the page
+       starts out all zeros. */
+    struct file *file;          /* File, or null. */
+    off_t file_ofs;             /* Offset in FILE. */
+    size_t file_bytes;          /* Bytes to read, 0...PGSIZE. */
+    bool write_back;            /* Write dirty page to FILE, not swap? */
+  };
+
+/* Default maximum size of a process's stack, in pages. */
+#define STACK_PAGES_DEFAULT 2048
+
+extern size_t stack_page_limit;
+extern bool page_print_stats;
+
+void page_init (void);
+bool page_table_create (void);
+void page_table_destroy (void);
+
+struct page *page_alloc (void *addr, bool writable);
+bool page_alloc_fixed (void *addr, void *kpage);
+void page_free (void *addr);
+struct page *page_lookup (const void *addr);
+bool page_in (void *fault_addr, bool write);
+bool page_grow_stack (void *fault_addr, const void *esp);
+bool page_copy_on_write (void *fault_addr);
+bool page_table_copy (struct thread *parent, struct file *executable);
+
+void page_report_stats (void);
+
+bool page_frame_accessed (struct frame *);
+bool page_frame_evict (struct frame *);
+
+#endif /* vm/page.h */
@@ -0,0 +1,111 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Swap partition.
+
+   The swap disk is divided into page-sized slots of
+   PAGE_SECTORS consecutive sectors each, tracked by a bitmap.
+   A slot is named by its first sector.  Pages that shared a
+   copy-on-write frame when it was evicted share its slot, so
+   each slot also counts its references. */
+
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+static struct disk *swap_disk;          /* Swap device, hd1:1. */
+static struct bitmap *swap_bitmap;      /* Slots in use. */
+static unsigned *swap_refs;             /* References to each slot. */
+static struct lock swap_lock;           /* Protects the above. */
+
+/* Finds the swap disk and sets up the slot allocator.  Without
+   a swap disk, swap_write() always fails. */
+void
+swap_init (void) 
+{
+  lock_init (&swap_lock);
+  swap_disk = disk_get (1, 1);
+  if (swap_disk == NULL)
+    {
+      printf ("swap: no swap disk, running without swap\n");
+      swap_bitmap = bitmap_create (0);
+    }
+  else
+    swap_bitmap = bitmap_create (disk_size (swap_disk) / PAGE_SECTORS);
+  /* One spare entry, so that even an empty swap area gets an
+     array. */
+  swap_refs = calloc (bitmap_size (swap_bitmap) + 1, sizeof *swap_refs);
+  if (swap_bitmap == NULL || swap_refs == NULL)
+    PANIC ("couldn't create swap bitmap");
+}
+
+/* Writes the page at KPAGE to a free swap slot.  Returns the
+   slot, or SWAP_NONE if swap is full. */
+disk_sector_t
+swap_write (const void *kpage) 
+{
+  const uint8_t *buf = kpage;
+  disk_sector_t sector;
+  size_t slot;
+  int i;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
+  if (slot != BITMAP_ERROR)
+    swap_refs[slot] = 1;
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return SWAP_NONE;
+
+  sector = slot * PAGE_SECTORS;
+  for (i = 0; i < PAGE_SECTORS; i++)
+    disk_write (swap_disk, sector + i, buf + i * DISK_SECTOR_SIZE);
+  return sector;
+}
+
+/* Reads swap slot SECTOR into KPAGE and drops one reference to
+   the slot. */
+void
+swap_read (disk_sector_t sector, void *kpage) 
+{
+  uint8_t *buf = kpage;
+  int i;
+
+  ASSERT (sector != SWAP_NONE);
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    disk_read (swap_disk, sector + i, buf + i * DISK_SECTOR_SIZE);
+  swap_discard (sector);
+}
+
+/* Adds a reference to swap slot SECTOR. */
+void
+swap_dup (disk_sector_t sector) 
+{
+  ASSERT (sector % PAGE_SECTORS == 0);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_bitmap, sector / PAGE_SECTORS));
+  swap_refs[sector / PAGE_SECTORS]++;
+  lock_release (&swap_lock);
+}
+
+/* Drops a reference to swap slot SECTOR without reading it,
+   freeing the slot when none remain. */
+void
+swap_discard (disk_sector_t sector) 
+{
+  size_t slot = sector / PAGE_SECTORS;
+
+  ASSERT (sector % PAGE_SECTORS == 0);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_bitmap, slot));
+  if (--swap_refs[slot] == 0)
+    bitmap_reset (swap_bitmap, slot);
+  lock_release (&swap_lock);
+}
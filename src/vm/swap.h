@@ -0,0 +1,16 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include "devices/disk.h"
+
+/* Returned by swap_write() when swap is full, and stored in a
+   page that has no swap slot. */
+#define SWAP_NONE ((disk_sector_t) -1)
+
+void swap_init (void);
+disk_sector_t swap_write (const void *kpage);
+void swap_read (disk_sector_t, void *kpage);
+void swap_dup (disk_sector_t);
+void swap_discard (disk_sector_t);
+
+#endif /* vm/swap.h */